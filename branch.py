@@ -23,7 +23,7 @@ files = branch + superscalar + dependencies + memory
 files = branch
 
 path_prefix = "/u/yzp7fe/processor/compile/"
-optimized = "/u/yzp7fe/processor/mips_cpu_1/processor"
+optimized = "/u/yzp7fe/processor/mips_cpu/processor"
 pipeline = "/u/yzp7fe/processor/pipeline/processor"
 no_branch_optimized = "/u/yzp7fe/processor/mips_cpu/processor"
 
@@ -34,8 +34,8 @@ for file in files:
 
     
     pipe_result = subprocess.run([pipeline, "-b", input_path, "-O1"], stdout=subprocess.PIPE, text=True)
-    opt_result = subprocess.run([optimized, "-b", input_path, "-O2"], stdout=subprocess.PIPE, text=True)
-    no_branch_result = subprocess.run([no_branch_optimized, "-b", input_path, "-O2"], stdout=subprocess.PIPE, text=True)
+    opt_result = subprocess.run([optimized, "-b", input_path, "-O2", "--quiet"], stdout=subprocess.PIPE, text=True)
+    no_branch_result = subprocess.run([no_branch_optimized, "-b", input_path, "-O2", "--quiet"], stdout=subprocess.PIPE, text=True)
 
     optimized_cycles.append(int(opt_result.stdout.strip()))
     pipeline_cycles.append(int(pipe_result.stdout.strip()))
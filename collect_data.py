@@ -49,7 +49,7 @@ for file in files:
     print("=== Running {} ===".format(file))
     
     optimized_result = subprocess.run(
-        [optimized, "-b", input_path, "-O2"],
+        [optimized, "-b", input_path, "-O2", "--quiet"],
         stdout=subprocess.PIPE,
         stderr=subprocess.STDOUT,
         text=True  # decode bytes to str automatically (works if Python 3.6+)
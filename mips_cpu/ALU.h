@@ -6,44 +6,65 @@
 class ALU {
     private:
         int ALU_control_inputs;
+        uint32_t hi_result;     // HI half of the last mult/div
     public:
-        // Generate the control inputs for the ALU
-        void generate_control_inputs(int ALU_op, int funct, int opcode) {
+        ALU() : ALU_control_inputs(2), hi_result(0) {}
+
+        // Control inputs the ALU needs for an instruction, without latching them
+        static int control_inputs(int ALU_op, int funct, int opcode) {
             if(!ALU_op) { // loads, stores
-                ALU_control_inputs = 2; // set to add
+                return 2; // set to add
             } 
             else if(ALU_op == 1) { // beq, bne
-                ALU_control_inputs = 6; // set to subtract
+                return 6; // set to subtract
             } 
             else if(ALU_op == 2) { // R-Type
                 switch(funct) {
-                    case 0x00: ALU_control_inputs = 3; break;               // sll
-                    case 0x02: ALU_control_inputs = 4; break;               // srl
-                    case 0x08: ALU_control_inputs = 2; break;               // don't care
-                    case 0x20: case 0x21: ALU_control_inputs = 2; break;    // add
-                    case 0x22: case 0x23: ALU_control_inputs = 6; break;    // sub
-                    case 0x24: ALU_control_inputs = 0; break;               // and
-                    case 0x25: ALU_control_inputs = 1; break;               // or
-                    case 0x27: ALU_control_inputs = 12; break;              // nor
-                    case 0x2a: case 0x2b: ALU_control_inputs = 7; break;    // slt
-                    default: ALU_control_inputs = 2;
+                    case 0x00: return 3;                // sll
+                    case 0x02: return 4;                // srl
+                    case 0x08: return 2;                // don't care
+                    case 0x10: case 0x12: return 2;     // mfhi, mflo (add HI/LO, $0)
+                    case 0x18: return 8;                // mult
+                    case 0x19: return 9;                // multu
+                    case 0x1a: return 10;               // div
+                    case 0x1b: return 11;               // divu
+                    case 0x20: case 0x21: return 2;     // add
+                    case 0x22: case 0x23: return 6;     // sub
+                    case 0x24: return 0;                // and
+                    case 0x25: return 1;                // or
+                    case 0x27: return 12;               // nor
+                    case 0x2a: case 0x2b: return 7;     // slt
+                    default: return 2;
                 }
             }
             else { // Other I-type
                 switch(opcode) {
-                    case 0x8: case 0x9: ALU_control_inputs = 2; break;      // add
-                    case 0xa: case 0xb: ALU_control_inputs = 7; break;      // slt
-                    case 0xc: ALU_control_inputs = 0; break;                // and
-                    case 0xd: ALU_control_inputs = 1; break;                // or
-                    case 0xf: ALU_control_inputs = 5; break;                // lui
-                    default: ALU_control_inputs = 2;
+                    case 0x8: case 0x9: return 2;       // add
+                    case 0xa: case 0xb: return 7;       // slt
+                    case 0xc: return 0;                 // and
+                    case 0xd: return 1;                 // or
+                    case 0xf: return 5;                 // lui
+                    default: return 2;
                 }
             }
         }
+
+        // Generate the control inputs for the ALU
+        void generate_control_inputs(int ALU_op, int funct, int opcode) {
+            ALU_control_inputs = control_inputs(ALU_op, funct, opcode);
+        }
+
+        // Latch control inputs computed ahead of time (see DecodedInst)
+        void set_control_inputs(int inputs) {
+            ALU_control_inputs = inputs;
+        }
         
-        // execute ALU operations, generate result, and set the zero control signal if necessary
+        // execute ALU operations, generate result, and set the zero control signal if necessary.
+        // mult/div return LO and leave HI in hi(). A zero divisor, whose result
+        // MIPS leaves unpredictable, divides by 1 instead, as does INT_MIN / -1
         uint32_t execute(uint32_t operand_1, uint32_t operand_2, uint32_t &ALU_zero) {
             uint32_t result = 0;
+            uint64_t product;
             switch(ALU_control_inputs) {
                 case 0: result = operand_1 & operand_2; break;
                 case 1: result = operand_1 | operand_2; break;
@@ -53,6 +74,26 @@ class ALU {
                 case 5: result = operand_2 << 16; break;
                 case 6: result = operand_1 - operand_2; break;
                 case 7: result = ((int)operand_1 < (int)operand_2) ? 1 : 0; break;
+                case 8:
+                    product = (uint64_t)((int64_t)(int32_t)operand_1 * (int32_t)operand_2);
+                    result = product;
+                    hi_result = product >> 32;
+                    break;
+                case 9:
+                    product = (uint64_t)operand_1 * operand_2;
+                    result = product;
+                    hi_result = product >> 32;
+                    break;
+                case 10:
+                    if (!operand_2 || (operand_1 == 0x80000000 && operand_2 == 0xffffffff)) operand_2 = 1;
+                    result = (int32_t)operand_1 / (int32_t)operand_2;
+                    hi_result = (int32_t)operand_1 % (int32_t)operand_2;
+                    break;
+                case 11:
+                    if (!operand_2) operand_2 = 1;
+                    result = operand_1 / operand_2;
+                    hi_result = operand_1 % operand_2;
+                    break;
                 case 12: result = ~(operand_1 | operand_2); break;
                 default: result = operand_1 + operand_2; break;
             }
@@ -64,6 +105,10 @@ class ALU {
             }
             return result;
         }
+
+        uint32_t hi() const {
+            return hi_result;
+        }
             
 };
 #endif
@@ -0,0 +1,1035 @@
+#ifndef BRANCH_PREDICTOR
+#define BRANCH_PREDICTOR
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <utility>
+#include <map>
+#include <algorithm>
+#include "checkpoint.h"
+#include "decode.h"
+
+// What a control transfer is, as far as the predictors care. Fetch gets it
+// from the predecoded form of the word (see DecodeCache::peek); a word that
+// was never predecoded counts as BRANCH_NONE
+enum BranchKind {
+    BRANCH_NONE,            // not a control transfer
+    BRANCH_CONDITIONAL,     // beq, bne
+    BRANCH_JUMP,            // j
+    BRANCH_CALL,            // jal
+    BRANCH_RETURN,          // jr $31
+    BRANCH_INDIRECT         // jr through any other register
+};
+
+inline BranchKind branchKind(const DecodedInst &decoded) {
+    const control_t &control = decoded.control;
+    if (control.branch) return BRANCH_CONDITIONAL;
+    if (control.jump_reg) return decoded.rs == 31 ? BRANCH_RETURN : BRANCH_INDIRECT;
+    if (control.jump) return control.link ? BRANCH_CALL : BRANCH_JUMP;
+    return BRANCH_NONE;
+}
+
+// Direction half of the branch predictor. predict() runs at fetch, along the
+// predicted path; update() runs at commit with the outcome. Predictors with
+// a global history shift it in predict(); the core keeps a copy per fetched
+// instruction (history()/setHistory()) to undo wrong-path predictions, and
+// flush() goes back to the committed history after a pipeline flush
+class DirectionPredictor {
+    public:
+        virtual ~DirectionPredictor() {}
+
+        // The spec that builds this predictor, sizes included
+        virtual std::string name() const = 0;
+
+        virtual bool predict(uint32_t pc, BranchKind kind) = 0;
+        virtual void update(uint32_t pc, BranchKind kind, bool taken) = 0;
+
+        virtual uint64_t history() const { return 0; }
+        virtual void setHistory(uint64_t) {}
+        virtual void flush() {}
+
+        virtual void save(CheckpointWriter &out) const = 0;
+        virtual void restore(CheckpointReader &in) = 0;
+};
+
+// Saturating counter in [0, max]
+inline void countTowards(uint8_t &counter, bool up, uint8_t max) {
+    if (up) {
+        if (counter < max) counter++;
+    } else {
+        if (counter > 0) counter--;
+    }
+}
+
+// Saturating signed counter in [min, max]
+inline void countTowards(int8_t &counter, bool up, int8_t min, int8_t max) {
+    if (up) {
+        if (counter < max) counter++;
+    } else {
+        if (counter > min) counter--;
+    }
+}
+
+// The original predictor: a 2-bit counter per PC, trained by every
+// committed instruction, so jumps learn to predict taken too
+class BimodalPredictor : public DirectionPredictor {
+    private:
+        std::vector<uint8_t> counters;
+
+        size_t index(uint32_t pc) const {
+            return (pc >> 2) & (counters.size() - 1);
+        }
+
+    public:
+        BimodalPredictor(size_t entries) : counters(entries, 1) {}
+
+        std::string name() const { return "bimodal:" + std::to_string(counters.size()); }
+
+        bool predict(uint32_t pc, BranchKind) {
+            return counters[index(pc)] >= 2;
+        }
+
+        void update(uint32_t pc, BranchKind, bool taken) {
+            countTowards(counters[index(pc)], taken, 3);
+        }
+
+        void save(CheckpointWriter &out) const { out.putVector(counters); }
+        void restore(CheckpointReader &in) { in.getVector(counters); }
+};
+
+// Predictors indexed with the global history of conditional branch
+// outcomes. Only conditional branches look them up and shift the history;
+// any other control transfer is predicted taken. A branch is trained at
+// commit with the committed history, which is what it was predicted with:
+// every misprediction flushes the younger instructions
+class GlobalHistoryPredictor : public DirectionPredictor {
+    private:
+        uint64_t speculative;   // along the fetch path, newest outcome in bit 0
+        uint64_t committed;
+
+    protected:
+        virtual bool lookup(uint32_t pc, uint64_t history) = 0;
+        virtual void train(uint32_t pc, uint64_t history, bool taken) = 0;
+        virtual void saveTables(CheckpointWriter &out) const = 0;
+        virtual void restoreTables(CheckpointReader &in) = 0;
+
+    public:
+        GlobalHistoryPredictor() : speculative(0), committed(0) {}
+
+        bool predict(uint32_t pc, BranchKind kind) {
+            if (kind != BRANCH_CONDITIONAL) {
+                return kind != BRANCH_NONE;
+            }
+            bool taken = lookup(pc, speculative);
+            speculative = speculative << 1 | taken;
+            return taken;
+        }
+
+        void update(uint32_t pc, BranchKind kind, bool taken) {
+            if (kind != BRANCH_CONDITIONAL) {
+                return;
+            }
+            train(pc, committed, taken);
+            committed = committed << 1 | taken;
+        }
+
+        uint64_t history() const { return speculative; }
+        void setHistory(uint64_t history) { speculative = history; }
+        void flush() { speculative = committed; }
+
+        void save(CheckpointWriter &out) const {
+            out.put(committed);
+            saveTables(out);
+        }
+
+        void restore(CheckpointReader &in) {
+            committed = speculative = in.get<uint64_t>();
+            restoreTables(in);
+        }
+};
+
+// 2-bit counters indexed by PC xor the last history_bits outcomes
+class GsharePredictor : public GlobalHistoryPredictor {
+    private:
+        std::vector<uint8_t> counters;
+        int history_bits;
+
+        size_t index(uint32_t pc, uint64_t history) const {
+            return ((pc >> 2) ^ (history & ((1ull << history_bits) - 1))) & (counters.size() - 1);
+        }
+
+    protected:
+        bool lookup(uint32_t pc, uint64_t history) { return counters[index(pc, history)] >= 2; }
+        void train(uint32_t pc, uint64_t history, bool taken) { countTowards(counters[index(pc, history)], taken, 3); }
+        void saveTables(CheckpointWriter &out) const { out.putVector(counters); }
+        void restoreTables(CheckpointReader &in) { in.getVector(counters); }
+
+    public:
+        GsharePredictor(size_t entries, int history_bits) : counters(entries, 1), history_bits(history_bits) {}
+
+        std::string name() const {
+            return "gshare:" + std::to_string(counters.size()) + ":" + std::to_string(history_bits);
+        }
+};
+
+// Alpha 21264 style: a local predictor (per-PC history selecting a 3-bit
+// counter) and a global one (2-bit counters by global history), with a
+// chooser, also by global history, trained towards whichever was right.
+// The local histories only hold committed outcomes
+class TournamentPredictor : public GlobalHistoryPredictor {
+    private:
+        std::vector<uint32_t> local_history;    // by PC
+        std::vector<uint8_t> local_counters;    // by local history
+        std::vector<uint8_t> global_counters;   // by global history
+        std::vector<uint8_t> choosers;          // >= 2 picks the global prediction
+
+        uint32_t &localHistory(uint32_t pc) { return local_history[(pc >> 2) & (local_history.size() - 1)]; }
+        bool localPrediction(uint32_t pc) { return local_counters[localHistory(pc)] >= 4; }
+        size_t globalIndex(uint64_t history) const { return history & (global_counters.size() - 1); }
+
+    protected:
+        bool lookup(uint32_t pc, uint64_t history) {
+            size_t g = globalIndex(history);
+            return choosers[g] >= 2 ? global_counters[g] >= 2 : localPrediction(pc);
+        }
+
+        void train(uint32_t pc, uint64_t history, bool taken) {
+            size_t g = globalIndex(history);
+            bool local = localPrediction(pc);
+            bool global = global_counters[g] >= 2;
+            if (local != global) {
+                countTowards(choosers[g], global == taken, 3);
+            }
+            uint32_t &lh = localHistory(pc);
+            countTowards(local_counters[lh], taken, 7);
+            countTowards(global_counters[g], taken, 3);
+            lh = ((lh << 1) | taken) & (local_counters.size() - 1);
+        }
+
+        void saveTables(CheckpointWriter &out) const {
+            out.putVector(local_history);
+            out.putVector(local_counters);
+            out.putVector(global_counters);
+            out.putVector(choosers);
+        }
+
+        void restoreTables(CheckpointReader &in) {
+            in.getVector(local_history);
+            in.getVector(local_counters);
+            in.getVector(global_counters);
+            in.getVector(choosers);
+        }
+
+    public:
+        // entries global counters and choosers; a quarter as many local
+        // histories and local counters
+        TournamentPredictor(size_t entries)
+            : local_history(entries / 4, 0), local_counters(entries / 4, 3),
+              global_counters(entries, 1), choosers(entries, 1) {}
+
+        std::string name() const { return "tournament:" + std::to_string(global_counters.size()); }
+};
+
+// TAGE without the statistical corrector and loop predictor of TAGE-SC-L: a
+// bimodal base and four partially tagged tables indexed with 5, 12, 27 and
+// 60 bits of history. The longest matching table provides the prediction;
+// mispredictions allocate an entry in a longer table
+class TagePredictor : public GlobalHistoryPredictor {
+    private:
+        static const int TABLES = 4;
+        static const int TAG_BITS = 9;
+        static const uint32_t USEFUL_RESET = 1 << 18;   // updates between halvings of the useful bits
+
+        struct Entry {
+            uint16_t tag;
+            int8_t counter;     // -4..3, taken if >= 0
+            uint8_t useful;     // 0..3
+        };
+
+        struct Match {
+            int provider;       // longest matching table, or -1
+            int alt;            // next longest, or -1 for the base
+            bool provider_taken;
+            bool alt_taken;
+            bool taken;         // the prediction
+            size_t index[TABLES];
+            uint16_t tag[TABLES];
+        };
+
+        std::vector<uint8_t> base;
+        std::vector<Entry> tables[TABLES];
+        int index_bits;
+        int8_t use_alt;         // -8..7; >= 0 trusts the alternate over a newly allocated entry
+        uint32_t updates;
+
+        static int historyLength(int table) {
+            static const int lengths[TABLES] = {5, 12, 27, 60};
+            return lengths[table];
+        }
+
+        // The newest length bits of history, xor-folded down to bits
+        static uint32_t fold(uint64_t history, int length, int bits) {
+            uint64_t h = history & ((1ull << length) - 1);
+            uint32_t folded = 0;
+            for (; h; h >>= bits) {
+                folded ^= h & ((1u << bits) - 1);
+            }
+            return folded;
+        }
+
+        Match match(uint32_t pc, uint64_t history) const {
+            Match m;
+            m.provider = m.alt = -1;
+            uint32_t word = pc >> 2;
+            for (int t = 0; t < TABLES; t++) {
+                int length = historyLength(t);
+                m.index[t] = (word ^ (word >> index_bits) ^ fold(history, length, index_bits)) & (tables[t].size() - 1);
+                m.tag[t] = (word ^ fold(history, length, TAG_BITS) ^ (fold(history, length, TAG_BITS - 1) << 1)) &
+                           ((1 << TAG_BITS) - 1);
+                if (tables[t][m.index[t]].tag == m.tag[t]) {
+                    m.alt = m.provider;
+                    m.provider = t;
+                }
+            }
+            bool base_taken = base[word & (base.size() - 1)] >= 2;
+            m.alt_taken = m.alt >= 0 ? tables[m.alt][m.index[m.alt]].counter >= 0 : base_taken;
+            if (m.provider < 0) {
+                m.provider_taken = m.taken = base_taken;
+                return m;
+            }
+            const Entry &entry = tables[m.provider][m.index[m.provider]];
+            m.provider_taken = entry.counter >= 0;
+            bool weak = entry.counter == 0 || entry.counter == -1;
+            m.taken = weak && use_alt >= 0 ? m.alt_taken : m.provider_taken;
+            return m;
+        }
+
+    protected:
+        bool lookup(uint32_t pc, uint64_t history) { return match(pc, history).taken; }
+
+        void train(uint32_t pc, uint64_t history, bool taken) {
+            Match m = match(pc, history);
+            if (m.provider >= 0) {
+                Entry &entry = tables[m.provider][m.index[m.provider]];
+                if (m.provider_taken != m.alt_taken) {
+                    if (entry.counter == 0 || entry.counter == -1) {
+                        countTowards(use_alt, m.alt_taken == taken, -8, 7);
+                    }
+                    countTowards(entry.useful, m.provider_taken == taken, 3);
+                }
+                countTowards(entry.counter, taken, -4, 3);
+            } else {
+                countTowards(base[(pc >> 2) & (base.size() - 1)], taken, 3);
+            }
+
+            if (m.taken != taken && m.provider < TABLES - 1) {
+                // Allocate in the shortest longer table with a free entry,
+                // or make room in all of them for next time
+                int t = m.provider + 1;
+                while (t < TABLES && tables[t][m.index[t]].useful) {
+                    t++;
+                }
+                if (t < TABLES) {
+                    tables[t][m.index[t]] = {m.tag[t], (int8_t)(taken ? 0 : -1), 0};
+                } else {
+                    for (t = m.provider + 1; t < TABLES; t++) {
+                        tables[t][m.index[t]].useful--;
+                    }
+                }
+            }
+
+            if (++updates % USEFUL_RESET == 0) {
+                for (auto &table : tables) {
+                    for (Entry &entry : table) {
+                        entry.useful >>= 1;
+                    }
+                }
+            }
+        }
+
+        void saveTables(CheckpointWriter &out) const {
+            out.putVector(base);
+            for (const auto &table : tables) {
+                out.putVector(table);
+            }
+            out.put(use_alt);
+            out.put(updates);
+        }
+
+        void restoreTables(CheckpointReader &in) {
+            in.getVector(base);
+            for (auto &table : tables) {
+                in.getVector(table);
+            }
+            use_alt = in.get<int8_t>();
+            updates = in.get<uint32_t>();
+        }
+
+    public:
+        // entries per tagged table; the base has four times as many
+        TagePredictor(size_t entries) : base(entries * 4, 1), index_bits(0), use_alt(0), updates(0) {
+            for (auto &table : tables) {
+                table.assign(entries, Entry{0, 0, 0});
+            }
+            while ((1u << index_bits) < entries) {
+                index_bits++;
+            }
+        }
+
+        std::string name() const { return "tage:" + std::to_string(tables[0].size()); }
+};
+
+// Jimenez and Lin's perceptron predictor: per perceptron (selected by PC) a
+// bias and a signed weight per history bit; the prediction is the sign of
+// the bias plus the weights, each negated where its branch was not taken.
+// Trained on a misprediction or when the sum is within the threshold
+class PerceptronPredictor : public GlobalHistoryPredictor {
+    private:
+        std::vector<int8_t> weights;    // history_bits + 1 per perceptron, bias first
+        size_t perceptrons;
+        int history_bits;
+        int threshold;
+
+        int8_t *row(uint32_t pc) { return &weights[((pc >> 2) % perceptrons) * (history_bits + 1)]; }
+
+        int output(const int8_t *w, uint64_t history) const {
+            int sum = w[0];
+            for (int i = 0; i < history_bits; i++) {
+                sum += (history >> i) & 1 ? w[i + 1] : -w[i + 1];
+            }
+            return sum;
+        }
+
+    protected:
+        bool lookup(uint32_t pc, uint64_t history) { return output(row(pc), history) >= 0; }
+
+        void train(uint32_t pc, uint64_t history, bool taken) {
+            int8_t *w = row(pc);
+            int sum = output(w, history);
+            if ((sum >= 0) == taken && std::abs(sum) > threshold) {
+                return;
+            }
+            countTowards(w[0], taken, -128, 127);
+            for (int i = 0; i < history_bits; i++) {
+                countTowards(w[i + 1], (bool)((history >> i) & 1) == taken, -128, 127);
+            }
+        }
+
+        void saveTables(CheckpointWriter &out) const { out.putVector(weights); }
+        void restoreTables(CheckpointReader &in) { in.getVector(weights); }
+
+    public:
+        PerceptronPredictor(size_t perceptrons, int history_bits)
+            : weights(perceptrons * (history_bits + 1), 0), perceptrons(perceptrons),
+              history_bits(history_bits), threshold((int)(1.93 * history_bits + 14)) {}
+
+        std::string name() const {
+            return "perceptron:" + std::to_string(perceptrons) + ":" + std::to_string(history_bits);
+        }
+};
+
+// Builds the predictor a --bpred spec names: bimodal[:<entries>],
+// gshare[:<entries>[:<history bits>]], tournament[:<entries>],
+// tage[:<entries per table>] or perceptron[:<perceptrons>[:<history bits>]].
+// Sizes are powers of two from 16 to 2^20 (perceptrons from 1); nullptr for
+// anything else
+inline std::unique_ptr<DirectionPredictor> makeDirectionPredictor(const std::string &spec)
+{
+    std::string name = spec.substr(0, spec.find(':'));
+    std::vector<long> params;
+    for (size_t colon = spec.find(':'); colon != std::string::npos; colon = spec.find(':', colon + 1)) {
+        char *end;
+        long value = strtol(spec.c_str() + colon + 1, &end, 10);
+        if (end == spec.c_str() + colon + 1 || (*end && *end != ':') || params.size() == 2) {
+            return nullptr;
+        }
+        params.push_back(value);
+    }
+    auto param = [&](size_t i, long fallback) { return i < params.size() ? params[i] : fallback; };
+    auto log2 = [](long n) { int bits = 0; while ((1l << bits) < n) bits++; return bits; };
+    auto size_ok = [](long n, long min) { return n >= min && n <= (1l << 20) && !(n & (n - 1)); };
+
+    DirectionPredictor *predictor = nullptr;
+    long entries;
+    if (name == "bimodal" && params.size() <= 1 && size_ok(entries = param(0, 1024), 16)) {
+        predictor = new BimodalPredictor(entries);
+    } else if (name == "gshare" && size_ok(entries = param(0, 4096), 16)) {
+        long history = param(1, log2(entries));
+        if (history >= 1 && history <= log2(entries)) predictor = new GsharePredictor(entries, history);
+    } else if (name == "tournament" && params.size() <= 1 && size_ok(entries = param(0, 4096), 16)) {
+        predictor = new TournamentPredictor(entries);
+    } else if (name == "tage" && params.size() <= 1 && size_ok(entries = param(0, 1024), 16)) {
+        predictor = new TagePredictor(entries);
+    } else if (name == "perceptron" && size_ok(entries = param(0, 256), 1)) {
+        long history = param(1, 32);
+        if (history >= 1 && history <= 62) predictor = new PerceptronPredictor(entries, history);
+    }
+    return std::unique_ptr<DirectionPredictor>(predictor);
+}
+
+// Return addresses of the calls in flight, newest on top. A push onto a
+// full stack overwrites the oldest entry; a pop from an empty one fails
+class ReturnAddressStack {
+    private:
+        std::vector<uint32_t> entries;
+        uint32_t top;       // slot of the newest entry
+        uint32_t count;     // entries in use, at most entries.size()
+
+    public:
+        // Enough to put the stack back as a snapshot found it, unless
+        // the wrong path popped past the top and pushed again
+        struct Snapshot {
+            uint32_t top;
+            uint32_t count;
+            uint32_t address;   // the entry at top
+        };
+
+        ReturnAddressStack(size_t depth) : entries(depth, 0), top(0), count(0) {}
+
+        size_t depth() const { return entries.size(); }
+
+        void push(uint32_t address) {
+            if (entries.empty()) return;
+            top = (top + 1) % entries.size();
+            entries[top] = address;
+            if (count < entries.size()) count++;
+        }
+
+        bool pop(uint32_t &address) {
+            if (!count) return false;
+            address = entries[top];
+            top = (top + entries.size() - 1) % entries.size();
+            count--;
+            return true;
+        }
+
+        Snapshot snapshot() const {
+            return {top, count, entries.empty() ? 0 : entries[top]};
+        }
+
+        void repair(const Snapshot &state) {
+            top = state.top;
+            count = state.count;
+            if (!entries.empty()) entries[top] = state.address;
+        }
+
+        void save(CheckpointWriter &out) const {
+            out.putVector(entries);
+            out.put(top);
+            out.put(count);
+        }
+
+        void restore(CheckpointReader &in) {
+            in.getVector(entries);
+            top = in.get<uint32_t>();
+            count = in.get<uint32_t>();
+            if (top >= entries.size() || count > entries.size()) top = count = 0;
+        }
+};
+
+// Targets of jr through registers other than $31, by PC hashed with the
+// path that led there: the PCs of the last few taken branches and jumps,
+// and for jr their targets. A hit overrides the BTB's last target, so a
+// dispatch jr gets one entry per path instead of one in all. Each entry
+// keeps a 2-bit confidence; a different target replaces it only at zero
+class IndirectTargetCache {
+    private:
+        static const int TAG_BITS = 12;
+
+        struct Entry {
+            uint16_t tag;
+            uint8_t confidence;
+            bool valid;
+            uint32_t target;
+        };
+
+        std::vector<Entry> entries;
+
+        size_t index(uint32_t pc, uint32_t path) const {
+            uint64_t hash = ((uint64_t)(pc >> 2) ^ path) * 0x9e3779b97f4a7c15ull;
+            return (hash >> 32) & (entries.size() - 1);
+        }
+
+        uint16_t tag(uint32_t pc, uint32_t path) const {
+            return ((pc >> 2) ^ (path >> 7) ^ (path << 3)) & ((1 << TAG_BITS) - 1);
+        }
+
+    public:
+        IndirectTargetCache(size_t size) : entries(size, Entry{0, 0, false, 0}) {}
+
+        size_t size() const { return entries.size(); }
+
+        // The path history after a taken control transfer at pc going to target
+        static uint32_t extendPath(uint32_t path, uint32_t pc, BranchKind kind, uint32_t target) {
+            uint32_t address = kind == BRANCH_INDIRECT || kind == BRANCH_RETURN ? target : pc;
+            return path << 4 ^ address >> 2;
+        }
+
+        bool lookup(uint32_t pc, uint32_t path, uint32_t &target) const {
+            if (entries.empty()) return false;
+            const Entry &entry = entries[index(pc, path)];
+            if (!entry.valid || entry.tag != tag(pc, path)) return false;
+            target = entry.target;
+            return true;
+        }
+
+        void train(uint32_t pc, uint32_t path, uint32_t target) {
+            if (entries.empty()) return;
+            Entry &entry = entries[index(pc, path)];
+            if (entry.valid && entry.tag == tag(pc, path) && entry.target == target) {
+                countTowards(entry.confidence, true, 3);
+            } else if (!entry.valid || entry.confidence == 0) {
+                entry = {tag(pc, path), 1, true, target};
+            } else {
+                entry.confidence--;
+            }
+        }
+
+        void save(CheckpointWriter &out) const { out.putVector(entries); }
+        void restore(CheckpointReader &in) { in.getVector(entries); }
+};
+
+// The loop component of TAGE-SC-L: for a conditional branch that goes one
+// way a fixed number of times and then the other, learns that trip count
+// and predicts the exit. Its predictions are trusted once the same count has
+// been seen CONFIDENT runs in a row. Iterations are counted at commit and,
+// ahead of that, along the fetch path; a flush copies the committed counts
+// back (decode redirects do not roll them back)
+class LoopPredictor {
+    private:
+        static const int WAYS = 4;
+        static const uint8_t CONFIDENT = 3;
+        static const uint8_t MAX_AGE = 7;
+        static const uint16_t MAX_ITERATIONS = 0xffff;
+
+        struct Entry {
+            uint16_t tag;
+            uint16_t trip;          // instances per run, the exit included; 0 while unknown
+            uint16_t iteration;     // instances that went direction so far this run, at commit
+            uint8_t confidence;     // runs in a row that matched trip
+            uint8_t age;            // replaceable at 0
+            bool valid;
+            bool direction;         // the outcome that repeats
+        };
+
+        std::vector<Entry> entries;
+        std::vector<uint16_t> speculative;  // iteration along the fetch path
+
+        size_t sets() const { return entries.size() / WAYS; }
+        uint16_t tag(uint32_t pc) const { return (pc >> 2) / sets() & 0x3fff; }
+
+        int find(uint32_t pc) const {
+            if (entries.empty()) return -1;
+            size_t set = (pc >> 2) & (sets() - 1);
+            for (size_t i = set * WAYS; i < (set + 1) * WAYS; i++) {
+                if (entries[i].valid && entries[i].tag == tag(pc)) return i;
+            }
+            return -1;
+        }
+
+        bool predictFrom(const Entry &entry, uint16_t iteration, bool &taken) const {
+            if (entry.confidence < CONFIDENT) return false;
+            taken = iteration + 1 == entry.trip ? !entry.direction : entry.direction;
+            return true;
+        }
+
+        // After a misprediction nothing here covered: take over a way of the
+        // branch's set whose age ran out, or age them all
+        void allocate(uint32_t pc, bool direction) {
+            size_t set = (pc >> 2) & (sets() - 1);
+            for (size_t i = set * WAYS; i < (set + 1) * WAYS; i++) {
+                if (!entries[i].valid || entries[i].age == 0) {
+                    entries[i] = {tag(pc), 0, 0, 0, MAX_AGE, true, direction};
+                    speculative[i] = 0;
+                    return;
+                }
+            }
+            for (size_t i = set * WAYS; i < (set + 1) * WAYS; i++) {
+                entries[i].age--;
+            }
+        }
+
+    public:
+        LoopPredictor(size_t size) : entries(size, Entry{0, 0, 0, 0, 0, false, false}), speculative(size, 0) {}
+
+        size_t size() const { return entries.size(); }
+
+        // Sizes: 0 or a power of two from WAYS to 4096
+        static bool validSize(long size) {
+            return size == 0 || (size >= WAYS && size <= 4096 && !(size & (size - 1)));
+        }
+
+        // Fetch: the prediction for pc, if there is a confident one
+        bool lookup(uint32_t pc, bool &taken) const {
+            int i = find(pc);
+            return i >= 0 && predictFrom(entries[i], speculative[i], taken);
+        }
+
+        // Fetch: count an instance of pc, predicted taken or not
+        void advance(uint32_t pc, bool taken) {
+            int i = find(pc);
+            if (i < 0) return;
+            uint16_t &iteration = speculative[i];
+            iteration = taken == entries[i].direction ? std::min<int>(iteration + 1, MAX_ITERATIONS) : 0;
+        }
+
+        // Commit: what lookup() said for this instance, given that nothing
+        // younger was mispredicted since
+        bool committedLookup(uint32_t pc, bool &taken) const {
+            int i = find(pc);
+            return i >= 0 && predictFrom(entries[i], entries[i].iteration, taken);
+        }
+
+        void train(uint32_t pc, bool taken, bool mispredicted) {
+            int i = find(pc);
+            if (i < 0) {
+                if (mispredicted && !entries.empty()) allocate(pc, !taken);
+                return;
+            }
+            Entry &entry = entries[i];
+            bool predicted;
+            if (predictFrom(entry, entry.iteration, predicted) && predicted == taken) {
+                entry.age = MAX_AGE;
+            }
+            if (taken == entry.direction) {
+                if (++entry.iteration == MAX_ITERATIONS) {
+                    entry.valid = false;    // too long a loop to count
+                } else if (entry.trip && entry.iteration >= entry.trip) {
+                    entry.trip = entry.confidence = 0;
+                }
+                return;
+            }
+            if (entry.iteration == 0) {
+                // Two exits in a row: allocated on a miss inside the loop,
+                // with the directions the wrong way round
+                entry = {entry.tag, 0, 1, 0, entry.age, true, taken};
+                return;
+            }
+            uint16_t trip = entry.iteration + 1;
+            if (trip == entry.trip) {
+                countTowards(entry.confidence, true, CONFIDENT);
+            } else {
+                entry.trip = trip;
+                entry.confidence = 0;
+            }
+            entry.iteration = 0;
+        }
+
+        void flush() {
+            for (size_t i = 0; i < entries.size(); i++) {
+                speculative[i] = entries[i].iteration;
+            }
+        }
+
+        void save(CheckpointWriter &out) const { out.putVector(entries); }
+
+        void restore(CheckpointReader &in) {
+            in.getVector(entries);
+            flush();
+        }
+};
+
+// A direction predictor (bimodal unless --bpred picks another) with a
+// direct-mapped BTB, a return address stack, an indirect target cache and a
+// loop predictor, used by the out-of-order core and trained by functional
+// warming
+class BranchPredictor {
+    public:
+        struct BTBEntry {
+            uint32_t tag;
+            uint32_t target;
+            bool valid;
+        };
+
+        static constexpr size_t BTB_ENTRIES = 1024;
+        static constexpr size_t DEFAULT_RAS_DEPTH = 16;
+        static constexpr size_t MAX_RAS_DEPTH = 1024;
+        static constexpr size_t DEFAULT_INDIRECT_ENTRIES = 256;
+        static constexpr size_t MAX_INDIRECT_ENTRIES = 1 << 16;
+        static constexpr size_t DEFAULT_LOOP_ENTRIES = 64;
+
+        // Speculative state fetch leaves behind each instruction, so a
+        // redirect in decode can roll back what the wrong path predicted
+        struct Snapshot {
+            uint64_t history;
+            ReturnAddressStack::Snapshot returns;
+            uint32_t path;
+        };
+
+        // ras_depth 0 leaves returns to the BTB, indirect_entries 0 other
+        // jr, and loop_entries 0 turns the loop predictor off
+        BranchPredictor(const std::string &spec = "bimodal", size_t ras_depth = DEFAULT_RAS_DEPTH,
+                        size_t indirect_entries = DEFAULT_INDIRECT_ENTRIES,
+                        size_t loop_entries = DEFAULT_LOOP_ENTRIES)
+            : BTB(BTB_ENTRIES),
+            direction(makeDirectionPredictor(spec)),
+            return_stack(ras_depth), committed_return_stack(ras_depth),
+            conditional(0), conditional_misses(0),
+            returns(0), return_misses(0), return_underflows(0),
+            indirect(indirect_entries), path(0), committed_path(0),
+            loops(loop_entries), loop_covered(0), loop_correct(0)
+        {}
+
+        static bool valid(const std::string &spec) {
+            return makeDirectionPredictor(spec) != nullptr;
+        }
+
+        // Indirect target cache sizes: 0 or a power of two up to MAX_INDIRECT_ENTRIES
+        static bool validIndirectEntries(long entries) {
+            return entries >= 0 && entries <= (long)MAX_INDIRECT_ENTRIES && !(entries & (entries - 1));
+        }
+
+        std::string name() const {
+            return direction->name();
+        }
+
+        size_t returnStackDepth() const {
+            return return_stack.depth();
+        }
+
+        size_t indirectEntries() const {
+            return indirect.size();
+        }
+
+        size_t loopEntries() const {
+            return loops.size();
+        }
+
+        // Empties every table and counter; the configuration stays
+        void reset() {
+            *this = BranchPredictor(name(), returnStackDepth(), indirectEntries(), loopEntries());
+        }
+
+        void printEntriesWithTarget() const {
+            for (size_t i = 0; i < BTB.size(); ++i) {
+            if (BTB[i].valid) {
+                std::cout << "Entry " << i << ": "
+                      << "Tag: " << BTB[i].tag
+                      << ", Target: " <<std::hex << BTB[i].target
+                      << std::endl;
+            }
+            }
+        }
+
+        void printStats(std::ostream &out) const {
+            out << "Branch predictor (" << name() << "): " << conditional << " conditional branches, " <<
+                   conditional_misses << " mispredicted";
+            if (conditional) {
+                out << " (" << std::fixed << std::setprecision(2) << 100.0 * conditional_misses / conditional << "%)";
+                out << std::defaultfloat;
+            }
+            out << "\n";
+            out << "Loop predictor (" << loopEntries() << " entries): " << loop_covered << " conditional branches covered";
+            if (conditional) {
+                out << " (" << std::fixed << std::setprecision(2) << 100.0 * loop_covered / conditional << "%)";
+                out << std::defaultfloat;
+            }
+            out << ", " << loop_correct << " predicted right";
+            if (loop_covered) {
+                out << " (" << std::fixed << std::setprecision(2) << 100.0 * loop_correct / loop_covered << "%)";
+                out << std::defaultfloat;
+            }
+            out << "\n";
+            out << "Return stack (" << returnStackDepth() << " entries): " << returns << " returns, " <<
+                   return_misses << " mispredicted";
+            if (returns) {
+                out << " (" << std::fixed << std::setprecision(2) << 100.0 * (returns - return_misses) / returns <<
+                       "% hit)";
+                out << std::defaultfloat;
+            }
+            out << ", " << return_underflows << " with the stack empty\n";
+
+            // Per jr, the ones that cost the most flushes first
+            uint64_t jumps = 0, misses = 0;
+            std::vector<std::pair<uint32_t, IndirectStats>> sites(indirect_stats.begin(), indirect_stats.end());
+            for (const auto &site : sites) {
+                jumps += site.second.jumps;
+                misses += site.second.misses;
+            }
+            out << "Indirect jumps (" << indirectEntries() << "-entry target cache): " << jumps << " jumps, " <<
+                   misses << " mispredicted";
+            if (jumps) {
+                out << " (" << std::fixed << std::setprecision(2) << 100.0 * misses / jumps << "%)";
+                out << std::defaultfloat;
+            }
+            out << "\n";
+            std::stable_sort(sites.begin(), sites.end(), [](const std::pair<uint32_t, IndirectStats> &a,
+                                                            const std::pair<uint32_t, IndirectStats> &b) {
+                return a.second.misses > b.second.misses;
+            });
+            const size_t shown = 10;
+            for (size_t i = 0; i < sites.size() && i < shown; i++) {
+                const IndirectStats &site = sites[i].second;
+                out << "  jr at 0x" << std::hex << std::setw(8) << std::setfill('0') << sites[i].first <<
+                       std::dec << std::setfill(' ') << ": " << site.jumps << " jumps, " << site.misses <<
+                       " mispredicted (" << std::fixed << std::setprecision(2) << 100.0 * site.misses / site.jumps <<
+                       "%)\n";
+                out << std::defaultfloat;
+            }
+            if (sites.size() > shown) {
+                out << "  (" << sites.size() - shown << " more)\n";
+            }
+        }
+
+        void save(CheckpointWriter &out) const {
+            out.section("BPRD");
+            direction->save(out);
+            out.putVector(BTB);
+            committed_return_stack.save(out);
+            indirect.save(out);
+            out.put(committed_path);
+            loops.save(out);
+        }
+
+        void restore(CheckpointReader &in) {
+            in.section("BPRD");
+            direction->restore(in);
+            in.getVector(BTB);
+            committed_return_stack.restore(in);
+            return_stack = committed_return_stack;
+            indirect.restore(in);
+            committed_path = path = in.get<uint32_t>();
+            loops.restore(in);
+        }
+
+        // Predict: return <taken or not, predicted target>
+        std::pair<bool, uint32_t> predict(uint32_t pc, BranchKind kind) {
+            bool predict_taken = direction->predict(pc, kind);
+            if (kind == BRANCH_CONDITIONAL) {
+                bool loop_taken;
+                if (loops.lookup(pc, loop_taken) && loop_taken != predict_taken) {
+                    predict_taken = loop_taken;
+                    // A global history took the direction predictor's guess
+                    // as its newest bit
+                    direction->setHistory(direction->history() ^ 1);
+                }
+                loops.advance(pc, predict_taken);
+            }
+
+            size_t btb_index = get_btb_index(pc);
+            const BTBEntry& entry = BTB[btb_index];
+
+            uint32_t predicted_target;
+            if (entry.valid && entry.tag == get_pc_tag(pc)) {
+                predicted_target = entry.target;
+                // std::cout << "Predicted target: " << predicted_target << std::endl;
+            } else {
+                predicted_target = pc + 4; // Default next instruction
+            }
+
+            // jal links pc + 8, where its jr $31 comes back to
+            if (kind == BRANCH_CALL) {
+                return_stack.push(pc + 8);
+            } else if (kind == BRANCH_RETURN && return_stack.pop(predicted_target)) {
+                predict_taken = true;
+            } else if (kind == BRANCH_INDIRECT && indirect.lookup(pc, path, predicted_target)) {
+                predict_taken = true;
+            }
+            if (predict_taken && kind != BRANCH_NONE) {
+                path = IndirectTargetCache::extendPath(path, pc, kind, predicted_target);
+            }
+
+            return {predict_taken, predicted_target};
+        }
+
+        // Update: after execution, update prediction structures.
+        // mispredicted says whether predict() got the direction wrong, or
+        // for jr the target
+        void update(uint32_t pc, BranchKind kind, bool actual_taken, uint32_t actual_target, bool mispredicted) {
+            if (kind == BRANCH_CONDITIONAL) {
+                conditional++;
+                conditional_misses += mispredicted;
+                bool loop_taken;
+                if (loops.committedLookup(pc, loop_taken)) {
+                    loop_covered++;
+                    loop_correct += loop_taken == actual_taken;
+                }
+                loops.train(pc, actual_taken, mispredicted);
+            } else if (kind == BRANCH_CALL) {
+                committed_return_stack.push(pc + 8);
+            } else if (kind == BRANCH_RETURN) {
+                uint32_t address;
+                returns++;
+                return_misses += mispredicted;
+                return_underflows += !committed_return_stack.pop(address);
+            } else if (kind == BRANCH_INDIRECT) {
+                IndirectStats &site = indirect_stats[pc];
+                site.jumps++;
+                site.misses += mispredicted;
+                indirect.train(pc, committed_path, actual_target);
+            }
+            if (actual_taken && kind != BRANCH_NONE) {
+                committed_path = IndirectTargetCache::extendPath(committed_path, pc, kind, actual_target);
+            }
+            direction->update(pc, kind, actual_taken);
+            if (actual_taken) {
+                size_t btb_index = get_btb_index(pc);
+                BTB[btb_index].tag = get_pc_tag(pc);
+                BTB[btb_index].target = actual_target;
+                BTB[btb_index].valid = true;
+            }
+        }
+
+        Snapshot snapshot() const {
+            return {direction->history(), return_stack.snapshot(), path};
+        }
+
+        // Back to the state right after the instruction snapshot() was taken for
+        void repair(const Snapshot &state) {
+            direction->setHistory(state.history);
+            return_stack.repair(state.returns);
+            path = state.path;
+        }
+
+        // After repair(): decode found that the instruction was a jump to
+        // target that fetch had predicted not taken
+        void jumpTaken(uint32_t pc, BranchKind kind, uint32_t target) {
+            path = IndirectTargetCache::extendPath(path, pc, kind, target);
+        }
+
+        // Forgets everything predicted past the last committed instruction
+        void flush() {
+            direction->flush();
+            return_stack = committed_return_stack;
+            path = committed_path;
+            loops.flush();
+        }
+
+    private:
+        std::vector<BTBEntry> BTB;
+        std::unique_ptr<DirectionPredictor> direction;
+        ReturnAddressStack return_stack;            // along the fetch path
+        ReturnAddressStack committed_return_stack;  // pushed and popped at commit
+        uint64_t conditional;           // conditional branches committed
+        uint64_t conditional_misses;    // of which predicted the wrong way
+        uint64_t returns;               // jr $31 committed
+        uint64_t return_misses;         // of which sent fetch to the wrong target
+        uint64_t return_underflows;     // of which found the committed stack empty
+
+        struct IndirectStats {
+            uint64_t jumps;
+            uint64_t misses;
+        };
+
+        IndirectTargetCache indirect;
+        uint32_t path;                  // path history along the fetch path
+        uint32_t committed_path;
+        std::map<uint32_t, IndirectStats> indirect_stats;   // by jr PC, other than jr $31
+
+        LoopPredictor loops;
+        uint64_t loop_covered;          // conditional branches it had a confident prediction for
+        uint64_t loop_correct;          // of which right
+
+        size_t get_btb_index(uint32_t pc) const {
+            return (pc >> 2) % BTB_ENTRIES;
+        }
+
+        uint32_t get_pc_tag(uint32_t pc) const {
+            return (pc >> 2);
+        }
+    };
+#endif
@@ -0,0 +1,35 @@
+#include <cstdint>
+#include "processor.h"
+using namespace std;
+
+// Checkpoints are taken at an instruction boundary: the out-of-order core is
+// drained first, so only architectural state, memory, the caches and the
+// branch predictor tables need saving.
+
+void Processor::endDrain() {
+    if (opt_level >= 2) {
+        regfile.pc = core_fetch_pc;
+        fetch_enabled = true;
+        restart_core = true;
+    }
+}
+
+void Processor::save(CheckpointWriter &out) {
+    // Write dirty lines back so the saved memory image is current for the
+    // untimed modes, which read it directly
+    memory->clean();
+    out.section("CPU ");
+    regfile.save(out);
+    branch_predictor.save(out);
+    memory->save(out);
+}
+
+bool Processor::restore(CheckpointReader &in) {
+    in.section("CPU ");
+    regfile.restore(in);
+    branch_predictor.restore(in);
+    memory->restore(in);
+    functional.invalidate();
+    restart_core = true;
+    return in.good();
+}
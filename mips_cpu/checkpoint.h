@@ -0,0 +1,109 @@
+#ifndef CHECKPOINT
+#define CHECKPOINT
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <zlib.h>
+
+// Checkpoints are a gzip stream: a magic string and a format version, then
+// tagged sections written by each component's save() in a fixed order.
+// Bump CHECKPOINT_VERSION whenever a section's layout changes so older
+// files are rejected instead of misread.
+#define CHECKPOINT_MAGIC "MIPSCKPT"
+#define CHECKPOINT_VERSION 7
+
+class CheckpointWriter {
+    private:
+        gzFile file;
+        bool ok;
+
+    public:
+        CheckpointWriter(const char *path) {
+            file = gzopen(path, "wb6");
+            ok = file != nullptr;
+            write(CHECKPOINT_MAGIC, 8);
+            put<uint32_t>(CHECKPOINT_VERSION);
+        }
+        ~CheckpointWriter() { close(); }
+
+        void write(const void *data, size_t bytes) {
+            const char *p = (const char *)data;
+            while (ok && bytes) {
+                unsigned chunk = bytes > (1u << 30) ? (1u << 30) : (unsigned)bytes;
+                if (gzwrite(file, p, chunk) != (int)chunk) ok = false;
+                p += chunk;
+                bytes -= chunk;
+            }
+        }
+
+        template <class T> void put(const T &value) { write(&value, sizeof(T)); }
+
+        template <class T> void putVector(const std::vector<T> &values) {
+            put<uint64_t>(values.size());
+            write(values.data(), values.size() * sizeof(T));
+        }
+
+        // Starts a section; tags are four characters
+        void section(const char *tag) { write(tag, 4); }
+
+        // Flushes and closes the file; false if anything failed along the way
+        bool close() {
+            if (file) {
+                if (gzclose(file) != Z_OK) ok = false;
+                file = nullptr;
+            }
+            return ok;
+        }
+};
+
+class CheckpointReader {
+    private:
+        gzFile file;
+        bool ok;
+
+    public:
+        CheckpointReader(const char *path) {
+            file = gzopen(path, "rb");
+            ok = file != nullptr;
+            char magic[8];
+            read(magic, 8);
+            ok = ok && !memcmp(magic, CHECKPOINT_MAGIC, 8) && get<uint32_t>() == CHECKPOINT_VERSION;
+        }
+        ~CheckpointReader() { if (file) gzclose(file); }
+
+        void read(void *data, size_t bytes) {
+            char *p = (char *)data;
+            while (ok && bytes) {
+                unsigned chunk = bytes > (1u << 30) ? (1u << 30) : (unsigned)bytes;
+                if (gzread(file, p, chunk) != (int)chunk) ok = false;
+                p += chunk;
+                bytes -= chunk;
+            }
+        }
+
+        template <class T> T get() {
+            T value = T();
+            read(&value, sizeof(T));
+            return value;
+        }
+
+        // Reads a vector written by putVector; the saved length must match
+        // the current size (structure geometry is not restored)
+        template <class T> void getVector(std::vector<T> &values) {
+            if (get<uint64_t>() != values.size()) ok = false;
+            read(values.data(), values.size() * sizeof(T));
+        }
+
+        // Checks that the next section carries this tag
+        void section(const char *tag) {
+            char found[4];
+            read(found, 4);
+            if (memcmp(found, tag, 4)) ok = false;
+        }
+
+        void fail() { ok = false; }
+
+        // False once anything was missing, truncated or did not match
+        bool good() const { return ok; }
+};
+#endif
@@ -23,6 +23,7 @@ struct control_t {
     bool ALU_src;            // 0 if second operand is from reg_file, 1 if imm
     bool reg_write;          // 1 if need to write back to reg file
     bool zero_extend;        // 1 if immediate needs to be zero-extended
+    bool hilo;               // 1 if mult/div: writes LO, and HI as well
     
     void print() {      // Prints the generated contol signals
         cout << "REG_DEST: " << reg_dest << "\n";
@@ -52,6 +53,7 @@ struct control_t {
         ALU_src = 0;           
         reg_write = 0;          
         zero_extend = 0;        
+        hilo = 0;
 
     }
     // Decode instructions into control signals
@@ -74,6 +76,11 @@ struct control_t {
                 jump_reg = 1;
             }
 
+            // Special Case: mult, multu, div, divu write HI and LO
+            if ((instruction & 0x3f) >= 0x18 && (instruction & 0x3f) <= 0x1b) {
+                hilo = 1;
+            }
+
             // Special Case: shift
             if ((instruction & 0x3f) == 0x0 || (instruction & 0x3f) == 0x2) {
                 shift = 1;
@@ -0,0 +1,111 @@
+#ifndef DECODE_CACHE
+#define DECODE_CACHE
+#include <vector>
+#include <cstdint>
+#include "control.h"
+#include "ALU.h"
+#include "regfile.h"
+
+// An instruction decoded once, with everything the cores would otherwise
+// re-derive from the raw word every time they see it
+struct DecodedInst {
+    uint32_t instruction;       // raw word this record was decoded from
+    control_t control;          // control signals
+    int opcode;
+    int rs;                     // REG_HI or REG_LO for mfhi/mflo
+    int rt;
+    int rd;
+    int shamt;
+    int funct;
+    uint32_t imm;               // sign- or zero-extended as the control signals ask
+    int write_reg;              // 31 for jal, REG_LO for mult/div, rd for R-type, rt otherwise
+    int ALU_control;            // ALU control inputs (see ALU::control_inputs)
+    uint32_t branch_target;     // pc + 4 + (imm << 2)
+    uint32_t jump_target;       // J-type target within the current 256 MB region
+
+    void decode(uint32_t word, uint32_t pc) {
+        instruction = word;
+        control.decode(word);
+        opcode = (word >> 26) & 0x3f;
+        rs = (word >> 21) & 0x1f;
+        rt = (word >> 16) & 0x1f;
+        rd = (word >> 11) & 0x1f;
+        shamt = (word >> 6) & 0x1f;
+        funct = word & 0x3f;
+        imm = word & 0xffff;
+        imm = control.zero_extend ? imm : (imm >> 15) ? 0xffff0000 | imm : imm;
+        write_reg = control.link ? 31 : control.hilo ? REG_LO : control.reg_dest ? rd : rt;
+        if (!opcode && (funct == 0x10 || funct == 0x12)) {
+            // mfhi/mflo execute as add rd, HI/LO, $0
+            rs = funct == 0x10 ? REG_HI : REG_LO;
+            rt = 0;
+        }
+        ALU_control = ALU::control_inputs(control.ALU_op, funct, opcode);
+        branch_target = pc + 4 + (imm << 2);
+        jump_target = ((pc + 4) & 0xf0000000) | ((word & 0x3ffffff) << 2);
+    }
+};
+
+// Per-PC cache of decoded instructions covering the text region. Filled when
+// the binary is loaded; Memory invalidates a slot whenever a store hits it.
+class DecodeCache {
+    private:
+        std::vector<DecodedInst> entries;
+        std::vector<bool> valid;
+        uint32_t base;
+        uint32_t size;
+        DecodedInst scratch;    // decode target for PCs outside the text region
+
+    public:
+        DecodeCache() : base(0), size(0) {}
+
+        // Covers [begin, begin+bytes); drops anything cached before
+        void setRegion(uint32_t begin, uint32_t bytes) {
+            base = begin;
+            size = bytes & ~3u;
+            entries.assign(size/4, DecodedInst());
+            valid.assign(size/4, false);
+        }
+
+        uint32_t regionBase() const { return base; }
+        uint32_t regionSize() const { return size; }
+
+        bool covers(uint32_t address) const {
+            return address - base < size;
+        }
+
+        void fill(uint32_t pc, uint32_t instruction) {
+            if (!covers(pc)) return;
+            entries[(pc - base)/4].decode(instruction, pc);
+            valid[(pc - base)/4] = true;
+        }
+
+        void invalidate(uint32_t address) {
+            if (covers(address)) valid[(address - base)/4] = false;
+        }
+
+        // The cached record for pc, if there is one, without a fetched word to
+        // check it against: fetch uses it to classify the word before it arrives
+        const DecodedInst *peek(uint32_t pc) const {
+            if (!covers(pc) || !valid[(pc - base)/4]) return nullptr;
+            return &entries[(pc - base)/4];
+        }
+
+        // Decoded form of the word fetched at pc. A cached record is used only
+        // if it was decoded from that same word; otherwise the word is decoded
+        // (and cached, inside the text region). The reference stays valid until
+        // the next lookup.
+        const DecodedInst &lookup(uint32_t pc, uint32_t instruction) {
+            if (!covers(pc)) {
+                scratch.decode(instruction, pc);
+                return scratch;
+            }
+            uint32_t slot = (pc - base)/4;
+            if (!valid[slot] || entries[slot].instruction != instruction) {
+                entries[slot].decode(instruction, pc);
+                valid[slot] = true;
+            }
+            return entries[slot];
+        }
+};
+#endif
@@ -0,0 +1,272 @@
+#include <cstdint>
+#include <iostream>
+#include "functional.h"
+using namespace std;
+
+// Longest straight-line run translated as one block
+#define MAX_BLOCK_LENGTH 64
+
+FunctionalSimulator::Block *FunctionalSimulator::translate(uint32_t pc) {
+    const PagedMemory &mem = memory->backing();
+    Block *block = new Block;
+    block->start = pc;
+    block->count = 0;
+
+    while (true) {
+        Op op = {};
+        op.pc = pc;
+        if (pc > end_pc || block->count == MAX_BLOCK_LENGTH) {
+            op.kind = OP_EXIT;
+            block->ops.push_back(op);
+            return block;
+        }
+
+        const DecodedInst &decoded = memory->predecode.lookup(pc, mem.load(pc));
+        const control_t &control = decoded.control;
+        op.rs = decoded.rs;
+        op.rt = decoded.rt;
+        op.write_reg = decoded.write_reg;
+        op.shamt = decoded.shamt;
+        op.reg_write = control.reg_write;
+        op.shift = control.shift;
+        op.ALU_src = control.ALU_src;
+        op.halfword = control.halfword;
+        op.byte = control.byte;
+        op.ALU_control = decoded.ALU_control;
+        op.imm = decoded.imm;
+
+        if (control.branch) {
+            op.kind = control.bne ? OP_BNE : OP_BEQ;
+            op.target = decoded.branch_target;
+        } else if (control.jump_reg) {
+            op.kind = OP_JR;
+        } else if (control.jump) {
+            op.kind = control.link ? OP_JAL : OP_J;
+            op.target = decoded.jump_target;
+        } else if (control.mem_read) {
+            op.kind = (control.halfword || control.byte) ? OP_LOAD_MASKED : OP_LW;
+        } else if (control.mem_write) {
+            op.kind = (control.halfword || control.byte) ? OP_STORE_MASKED : OP_SW;
+        } else if (control.hilo) {
+            op.kind = OP_MULDIV;
+        } else if (!control.reg_write) {
+            op.kind = OP_ALU;
+        } else if (control.shift) {
+            op.kind = decoded.ALU_control == 3 ? OP_SLL : decoded.ALU_control == 4 ? OP_SRL : OP_ALU;
+        } else if (!control.ALU_src) {
+            switch (decoded.ALU_control) {
+                case 0: op.kind = OP_AND; break;
+                case 1: op.kind = OP_OR; break;
+                case 2: op.kind = OP_ADD; break;
+                case 6: op.kind = OP_SUB; break;
+                case 7: op.kind = OP_SLT; break;
+                case 12: op.kind = OP_NOR; break;
+                default: op.kind = OP_ALU; break;
+            }
+        } else {
+            switch (decoded.ALU_control) {
+                case 0: op.kind = OP_ANDI; break;
+                case 1: op.kind = OP_ORI; break;
+                case 2: op.kind = OP_ADDI; break;
+                case 5: op.kind = OP_LUI; break;
+                case 7: op.kind = OP_SLTI; break;
+                default: op.kind = OP_ALU; break;
+            }
+        }
+
+        block->ops.push_back(op);
+        block->count++;
+        if (control.branch || control.jump) {
+            return block;
+        }
+        pc += 4;
+    }
+}
+
+uint64_t FunctionalSimulator::run(Registers &regfile, uint32_t last_pc, uint64_t max_insts) {
+    if (last_pc != end_pc || blocks.empty()) {
+        end_pc = last_pc;
+        blocks.clear();
+        blocks.resize(end_pc/4 + 1);
+        if (code) flushNative();
+    }
+    if (code) {
+        return runNative(regfile, max_insts);
+    }
+    return interpret(regfile, max_insts);
+}
+
+uint64_t FunctionalSimulator::interpret(Registers &regfile, uint64_t max_insts) {
+    static const void *const handlers[NUM_OPS] = {
+        &&do_add, &&do_sub, &&do_and, &&do_or, &&do_nor, &&do_slt, &&do_sll, &&do_srl,
+        &&do_addi, &&do_slti, &&do_andi, &&do_ori, &&do_lui,
+        &&do_alu, &&do_muldiv,
+        &&do_lw, &&do_load_masked, &&do_sw, &&do_store_masked,
+        &&do_beq, &&do_bne, &&do_j, &&do_jal, &&do_jr,
+        &&do_exit
+    };
+
+    // Architectural registers live in locals for the duration of the run
+    uint32_t R[NUM_REGS];
+    for (int i = 0; i < NUM_REGS; i++) {
+        uint32_t unused;
+        regfile.access(i, 0, R[i], unused, 0, false, 0);
+    }
+    PagedMemory &mem = memory->backing();
+    uint32_t pc = regfile.pc;
+    uint64_t retired = 0;
+
+    Block *block = nullptr;
+    Op *op = nullptr;
+    Block **chain = nullptr;    // successor slot to patch once the next block is known
+    Block partial;              // head of a block cut short by max_insts
+
+#define NEXT() do { ++op; goto *op->handler; } while (0)
+#define FOLLOW(slot) do { chain = &(slot); if (*chain) { block = *chain; goto enter; } goto lookup; } while (0)
+
+lookup:
+    if (flush_pending) {
+        for (auto &slot : blocks) slot.reset();
+        flush_pending = false;
+        chain = nullptr;
+    }
+    if (pc > end_pc || retired >= max_insts) {
+        goto done;
+    }
+    {
+        std::unique_ptr<Block> &slot = blocks[pc/4];
+        if (slot && slot->start != pc) {
+            // An unaligned target aliases a cached block; chained pointers may
+            // reach the old one, so start over rather than replace it in place
+            flush_pending = true;
+            goto lookup;
+        }
+        if (!slot) {
+            slot.reset(translate(pc));
+            for (Op &o : slot->ops) o.handler = handlers[o.kind];
+        }
+        block = slot.get();
+        if (chain) *chain = block;
+        chain = nullptr;
+    }
+
+enter:
+    if (block->count > max_insts - retired) {
+        partial.start = block->start;
+        partial.count = max_insts - retired;
+        partial.ops.assign(block->ops.begin(), block->ops.begin() + partial.count);
+        Op stop = {};
+        stop.kind = OP_EXIT;
+        stop.handler = handlers[OP_EXIT];
+        stop.pc = block->ops[partial.count].pc;
+        partial.ops.push_back(stop);
+        block = &partial;
+    }
+    retired += block->count;
+    op = block->ops.data();
+    goto *op->handler;
+
+do_add:  R[op->write_reg] = R[op->rs] + R[op->rt]; NEXT();
+do_sub:  R[op->write_reg] = R[op->rs] - R[op->rt]; NEXT();
+do_and:  R[op->write_reg] = R[op->rs] & R[op->rt]; NEXT();
+do_or:   R[op->write_reg] = R[op->rs] | R[op->rt]; NEXT();
+do_nor:  R[op->write_reg] = ~(R[op->rs] | R[op->rt]); NEXT();
+do_slt:  R[op->write_reg] = (int)R[op->rs] < (int)R[op->rt]; NEXT();
+do_sll:  R[op->write_reg] = R[op->rt] << op->shamt; NEXT();
+do_srl:  R[op->write_reg] = R[op->rt] >> op->shamt; NEXT();
+do_addi: R[op->write_reg] = R[op->rs] + op->imm; NEXT();
+do_slti: R[op->write_reg] = (int)R[op->rs] < (int)op->imm; NEXT();
+do_andi: R[op->write_reg] = R[op->rs] & op->imm; NEXT();
+do_ori:  R[op->write_reg] = R[op->rs] | op->imm; NEXT();
+do_lui:  R[op->write_reg] = op->imm << 16; NEXT();
+
+do_alu: {
+    // Uncommon operations go through the ALU model itself
+    ALU alu;
+    uint32_t alu_zero;
+    alu.set_control_inputs(op->ALU_control);
+    uint32_t result = alu.execute(op->shift ? op->shamt : R[op->rs], op->ALU_src ? op->imm : R[op->rt], alu_zero);
+    if (op->reg_write) R[op->write_reg] = result;
+    NEXT();
+}
+
+do_muldiv: {
+    ALU alu;
+    uint32_t alu_zero;
+    alu.set_control_inputs(op->ALU_control);
+    R[REG_LO] = alu.execute(R[op->rs], R[op->rt], alu_zero);
+    R[REG_HI] = alu.hi();
+    NEXT();
+}
+
+do_lw:
+    R[op->write_reg] = mem.load(R[op->rs] + op->imm);
+    NEXT();
+
+do_load_masked:
+    R[op->write_reg] = mem.load(R[op->rs] + op->imm) & (op->halfword ? 0xffff : 0xff);
+    NEXT();
+
+do_sw: {
+    uint32_t address = R[op->rs] + op->imm;
+    mem.store(address, R[op->rt]);
+    goto stored;
+}
+
+do_store_masked: {
+    uint32_t address = R[op->rs] + op->imm;
+    uint32_t old = mem.load(address);
+    mem.store(address, op->halfword ? (old & 0xffff0000) | (R[op->rt] & 0xffff) :
+                                      (old & 0xffffff00) | (R[op->rt] & 0xff));
+    goto stored;
+}
+
+stored: {
+    uint32_t address = R[op->rs] + op->imm;
+    if (address/4 > end_pc/4) NEXT();
+    // Self-modifying store: drop the translations and resume after the store
+    memory->predecode.invalidate(address & ~3u);
+    flush_pending = true;
+    retired -= block->count - (op - block->ops.data() + 1);
+    pc = op->pc + 4;
+    chain = nullptr;
+    goto lookup;
+}
+
+do_beq:
+    if (R[op->rs] == R[op->rt]) { pc = op->target; FOLLOW(op->taken); }
+    pc = op->pc + 4;
+    FOLLOW(op->not_taken);
+
+do_bne:
+    if (R[op->rs] != R[op->rt]) { pc = op->target; FOLLOW(op->taken); }
+    pc = op->pc + 4;
+    FOLLOW(op->not_taken);
+
+do_jal:
+    R[31] = op->pc + 8;
+    // fall through
+do_j:
+    pc = op->target;
+    FOLLOW(op->taken);
+
+do_jr:
+    pc = R[op->rs];
+    chain = nullptr;
+    goto lookup;
+
+do_exit:
+    pc = op->pc;
+    FOLLOW(op->taken);
+
+#undef NEXT
+#undef FOLLOW
+
+done:
+    for (int i = 0; i < NUM_REGS; i++) {
+        uint32_t unused;
+        regfile.access(0, 0, unused, unused, i, true, R[i]);
+    }
+    regfile.pc = pc;
+    return retired;
+}
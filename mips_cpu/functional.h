@@ -0,0 +1,103 @@
+#ifndef FUNCTIONAL_SIM
+#define FUNCTIONAL_SIM
+#include <vector>
+#include <cstdint>
+#include <memory>
+#include "memory.h"
+#include "regfile.h"
+
+// Untimed functional simulation. Basic blocks are translated from the predecode
+// cache into streams of handler addresses and run with direct threading
+// (computed goto), or optionally compiled to x86-64 (see jit.cpp). Nothing
+// touches the caches, MSHRs or cycle counters; the architectural result
+// matches the single-cycle core.
+class FunctionalSimulator {
+    private:
+        enum OpKind {
+            OP_ADD, OP_SUB, OP_AND, OP_OR, OP_NOR, OP_SLT, OP_SLL, OP_SRL,     // R-type
+            OP_ADDI, OP_SLTI, OP_ANDI, OP_ORI, OP_LUI,                          // I-type
+            OP_ALU,                                                             // anything else the ALU computes
+            OP_MULDIV,                                                          // mult/div into HI and LO
+            OP_LW, OP_LOAD_MASKED, OP_SW, OP_STORE_MASKED,
+            OP_BEQ, OP_BNE, OP_J, OP_JAL, OP_JR,
+            OP_EXIT,                                                            // leave the block at pc
+            NUM_OPS
+        };
+
+        struct Block;
+
+        struct Op {
+            const void *handler;    // filled in by interpret(), which owns the labels
+            OpKind kind;
+            uint8_t rs;
+            uint8_t rt;
+            uint8_t write_reg;
+            uint8_t shamt;
+            bool reg_write;
+            bool shift;
+            bool ALU_src;
+            bool halfword;
+            bool byte;
+            int ALU_control;
+            uint32_t imm;
+            uint32_t pc;
+            uint32_t target;        // branch/jump target
+            Block *taken;           // chained successor blocks, resolved lazily
+            Block *not_taken;
+        };
+
+        struct Block {
+            uint32_t start;
+            uint32_t count;         // instructions in the block (OP_EXIT excluded)
+            std::vector<Op> ops;
+        };
+
+        // State shared with translated x86-64 code, addressed through rbx
+        struct JitContext {
+            uint32_t R[NUM_REGS];
+            uint32_t pc;                // where the native code stopped
+            uint32_t reason;            // JIT_EXIT_*
+            uint64_t remaining;         // instruction budget left
+            uint8_t *patch;             // rel32 to link to the next block, or nullptr
+            uint32_t store_address;     // text word hit by a self-modifying store, or the
+                                        // address of a store to a shared page
+        };
+
+        Memory *memory;
+        uint32_t end_pc;
+        std::vector<std::unique_ptr<Block> > blocks;    // indexed by pc/4, only for pc <= end_pc
+        bool flush_pending;
+
+        // Native backend (jit.cpp); code is nullptr unless enableJit() succeeded
+        uint8_t *code;                  // mmap'd executable buffer
+        uint8_t *code_free;             // first unused byte
+        uint8_t *exit_stub;             // common epilogue every block leaves through
+        std::vector<uint8_t *> native;  // block entry points, indexed by pc/4
+        std::vector<uint32_t> native_start;
+
+        // Translates the block starting at pc; handlers are patched in by interpret()
+        Block *translate(uint32_t pc);
+
+        uint64_t interpret(Registers &regfile, uint64_t max_insts);
+
+        // Emits x86-64 code for the block starting at pc and returns its entry
+        uint8_t *compile(uint32_t pc);
+        void flushNative();
+        uint64_t runNative(Registers &regfile, uint64_t max_insts);
+
+    public:
+        FunctionalSimulator(Memory *mem) : memory(mem), end_pc(0), flush_pending(false), code(nullptr) {}
+        ~FunctionalSimulator();
+
+        // Runs from regfile.pc until the PC passes last_pc or max_insts instructions
+        // have retired, and returns the number retired
+        uint64_t run(Registers &regfile, uint32_t last_pc, uint64_t max_insts);
+
+        // Switches run() to translated x86-64 code. Returns false (and keeps
+        // the interpreter) on other hosts or if no executable memory is available
+        bool enableJit();
+
+        // Drops every translated block (the text was modified)
+        void invalidate() { flush_pending = true; if (code) flushNative(); }
+};
+#endif
@@ -0,0 +1,438 @@
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <sys/mman.h>
+#include "functional.h"
+#include "jit.h"
+using namespace std;
+
+// Native backend for the functional simulator: each basic block that
+// translate() produces is compiled to x86-64. Guest registers live in the
+// JitContext; the most used ones are held in host registers while a block
+// runs. Direct branches first point at a stub that returns to runNative(),
+// which links the branch straight to the successor once it is compiled.
+// Indirect jumps, self-modifying stores, stores to a page that is not
+// allocated yet and running out of budget always return to runNative().
+
+#define JIT_BUFFER_SIZE (64 << 20)
+#define JIT_BLOCK_RESERVE (64 << 10)    // worst case for one block and its stubs
+#define JIT_TRAMPOLINE_SIZE 128         // entry and exit code at the start of the buffer
+
+enum JitExit {
+    JIT_EXIT_CHAIN,     // continue at pc; link patch (if set) to it
+    JIT_EXIT_BUDGET,    // the block at pc needs more instructions than remain
+    JIT_EXIT_STORE,     // a store hit the text; resume at pc after flushing
+    JIT_EXIT_PAGE       // the store at pc found a shared page; copy it and rerun
+};
+
+#if defined(__x86_64__)
+
+// Host registers handed out to guest registers, in order of preference.
+// rax, rcx and rbp are scratch, rbx holds the context, r12 the guest page
+// directory and r13 the remaining budget.
+static const int allocatable[] = { RDX, RSI, RDI, R8, R9, R10, R11, R14, R15 };
+#define NUM_ALLOCATABLE (int)(sizeof(allocatable)/sizeof(allocatable[0]))
+
+#define CONTEXT_REG(r) (int32_t)(offsetof(JitContext, R) + 4*(r))
+#define CONTEXT_FIELD(f) (int32_t)offsetof(JitContext, f)
+
+bool FunctionalSimulator::enableJit() {
+    if (code) return true;
+    void *buffer = mmap(nullptr, JIT_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer == MAP_FAILED) return false;
+    code = (uint8_t *)buffer;
+
+    // void enter(JitContext *context, PagedMemory::Table *const *dir, uint8_t *block)
+    X86Emitter x(code);
+    x.push(RBX); x.push(RBP); x.push(R12); x.push(R13); x.push(R14); x.push(R15);
+    x.regReg(X86_STORE, RDI, RBX, true);
+    x.regReg(X86_STORE, RSI, R12, true);
+    x.regContext(X86_LOAD, R13, CONTEXT_FIELD(remaining), true);
+    x.jmpReg(RDX);
+
+    // Blocks leave with the next pc in eax and the rel32 to link in rcx
+    exit_stub = x.pos();
+    x.regContext(X86_STORE, RAX, CONTEXT_FIELD(pc));
+    x.regContext(X86_STORE, R13, CONTEXT_FIELD(remaining), true);
+    x.regContext(X86_STORE, RCX, CONTEXT_FIELD(patch), true);
+    x.pop(R15); x.pop(R14); x.pop(R13); x.pop(R12); x.pop(RBP); x.pop(RBX);
+    x.ret();
+
+    flushNative();
+    return true;
+}
+
+FunctionalSimulator::~FunctionalSimulator() {
+    if (code) munmap(code, JIT_BUFFER_SIZE);
+}
+
+void FunctionalSimulator::flushNative() {
+    code_free = code + JIT_TRAMPOLINE_SIZE;
+    native.assign(end_pc/4 + 1, nullptr);
+    native_start.assign(end_pc/4 + 1, 0);
+}
+
+uint8_t *FunctionalSimulator::compile(uint32_t pc) {
+    unique_ptr<Block> block(translate(pc));
+    const uint32_t count = block->count;
+
+    // Give host registers to the most used guest registers. Anything that may
+    // be written is stored back on every exit; storing an unmodified value is
+    // harmless, so "written anywhere in the block" is good enough.
+    int uses[NUM_REGS] = {0};
+    bool written[NUM_REGS] = {false};
+    for (const Op &op : block->ops) {
+        if (op.kind == OP_EXIT) continue;
+        uses[op.rs]++;
+        uses[op.rt]++;
+        bool writes = op.kind < OP_ALU || op.kind == OP_LW || op.kind == OP_LOAD_MASKED ||
+                      op.kind == OP_JAL || (op.kind == OP_ALU && op.reg_write);
+        if (writes) {
+            uses[op.write_reg]++;
+            written[op.write_reg] = true;
+        }
+        if (op.kind == OP_MULDIV) {
+            uses[REG_LO]++;
+            uses[REG_HI]++;
+            written[REG_LO] = written[REG_HI] = true;
+        }
+    }
+    int order[NUM_REGS];
+    for (int i = 0; i < NUM_REGS; i++) order[i] = i;
+    stable_sort(order, order + NUM_REGS, [&](int a, int b) { return uses[a] > uses[b]; });
+    int host[NUM_REGS];
+    fill(host, host + NUM_REGS, -1);
+    for (int i = 0; i < NUM_ALLOCATABLE && uses[order[i]]; i++) {
+        host[order[i]] = allocatable[i];
+    }
+
+    X86Emitter x(code_free);
+
+    // op reg, guest
+    auto apply = [&](uint8_t opcode, int reg, int guest) {
+        if (opcode == X86_LOAD && host[guest] == reg) return;
+        if (host[guest] >= 0) x.regReg(opcode, reg, host[guest]);
+        else x.regContext(opcode, reg, CONTEXT_REG(guest));
+    };
+    auto assign = [&](int guest, int reg) {
+        if (host[guest] >= 0) x.regReg(X86_STORE, reg, host[guest]);
+        else x.regContext(X86_STORE, reg, CONTEXT_REG(guest));
+    };
+    auto writeBack = [&]() {
+        for (int i = 0; i < NUM_REGS; i++) {
+            if (host[i] >= 0 && written[i]) x.regContext(X86_STORE, host[i], CONTEXT_REG(i));
+        }
+    };
+
+    // Out-of-line exits, emitted after the block body
+    struct Stub {
+        uint8_t *site;
+        JitExit reason;
+        uint32_t pc;
+        uint32_t refund;        // budget handed back (self-modifying stores)
+        bool write_back;
+    };
+    vector<Stub> stubs;
+    auto chainTo = [&](uint8_t *site, uint32_t target) {
+        stubs.push_back({site, JIT_EXIT_CHAIN, target, 0, false});
+    };
+
+    // Registers are loaded once; a single-block loop branches back to head
+    // and stays in host registers while the budget lasts
+    uint8_t *entry = x.pos();
+    for (int i = 0; i < NUM_REGS; i++) {
+        if (host[i] >= 0) x.regContext(X86_LOAD, host[i], CONTEXT_REG(i));
+    }
+    uint8_t *head = x.pos();
+    x.immediate(EXT_SUB, R13, count, true);
+    stubs.push_back({x.jcc(CC_B), JIT_EXIT_BUDGET, pc, count, true});
+
+    // write_reg = rs op (rt or imm), computed in the destination's host
+    // register when that cannot clobber an operand
+    auto binary = [&](const Op &op, uint8_t opcode, int ext, bool immediate) {
+        int dst = host[op.write_reg];
+        if (dst < 0 || (!immediate && op.rt == op.write_reg && op.rs != op.write_reg)) dst = RAX;
+        apply(X86_LOAD, dst, op.rs);
+        if (immediate) x.immediate(ext, dst, op.imm);
+        else apply(opcode, dst, op.rt);
+        if (dst == RAX) assign(op.write_reg, RAX);
+    };
+
+    // eax = (rs + imm) & ~3, the guest address of the word, and rcx its host
+    // address, from the page tables. A store reads the table's writable
+    // entry instead; if the page is still shared (the zero page, or one
+    // borrowed from the ELF file) it leaves for runNative() to copy it, and
+    // runs again from there
+    auto address = [&](const Op &op, size_t i, bool store) {
+        apply(X86_LOAD, RAX, op.rs);
+        if (op.imm) x.immediate(EXT_ADD, RAX, op.imm);
+        x.immediate(EXT_AND, RAX, ~3u);
+        x.regReg(X86_LOAD, RCX, RAX);
+        x.shiftImm(EXT_SHR, RCX, MEM_DIR_SHIFT);
+        x.loadScaled(RCX, R12, RCX);
+        x.regReg(X86_LOAD, RBP, RAX);
+        x.shiftImm(EXT_SHR, RBP, MEM_PAGE_BITS);
+        x.immediate(EXT_AND, RBP, MEM_TABLE_SIZE - 1);
+        if (store) {
+            x.loadScaled(RCX, RCX, RBP, offsetof(PagedMemory::Table, writable));
+            x.regReg(X86_TEST, RCX, RCX, true);
+            stubs.push_back({x.jcc(CC_E), JIT_EXIT_PAGE, op.pc, (uint32_t)(count - i), true});
+        } else {
+            x.loadScaled(RCX, RCX, RBP);
+        }
+        x.regReg(X86_LOAD, RBP, RAX);
+        x.immediate(EXT_AND, RBP, (1 << MEM_PAGE_BITS) - 1);
+        x.regReg(X86_ADD, RCX, RBP, true);
+    };
+
+    for (size_t i = 0; i < block->ops.size(); i++) {
+        const Op &op = block->ops[i];
+        switch (op.kind) {
+            case OP_ADD: binary(op, X86_ADD, 0, false); break;
+            case OP_SUB: binary(op, X86_SUB, 0, false); break;
+            case OP_AND: binary(op, X86_AND, 0, false); break;
+            case OP_OR:  binary(op, X86_OR, 0, false); break;
+            case OP_NOR:
+                apply(X86_LOAD, RAX, op.rs);
+                apply(X86_OR, RAX, op.rt);
+                x.notReg(RAX);
+                assign(op.write_reg, RAX);
+                break;
+            case OP_SLT:
+                apply(X86_LOAD, RAX, op.rs);
+                apply(X86_CMP, RAX, op.rt);
+                x.setLessEax();
+                assign(op.write_reg, RAX);
+                break;
+            case OP_SLL: apply(X86_LOAD, RAX, op.rt); x.shiftImm(EXT_SHL, RAX, op.shamt); assign(op.write_reg, RAX); break;
+            case OP_SRL: apply(X86_LOAD, RAX, op.rt); x.shiftImm(EXT_SHR, RAX, op.shamt); assign(op.write_reg, RAX); break;
+            case OP_ADDI: binary(op, 0, EXT_ADD, true); break;
+            case OP_ANDI: binary(op, 0, EXT_AND, true); break;
+            case OP_ORI:  binary(op, 0, EXT_OR, true); break;
+            case OP_SLTI:
+                apply(X86_LOAD, RAX, op.rs);
+                x.immediate(EXT_CMP, RAX, op.imm);
+                x.setLessEax();
+                assign(op.write_reg, RAX);
+                break;
+            case OP_LUI: x.movImm(RAX, op.imm << 16); assign(op.write_reg, RAX); break;
+
+            case OP_ALU:
+                // ALU::execute(operand_1, operand_2) with operand_1 in ecx (so
+                // it can be a shift count) and operand_2 in eax
+                if (op.shift) x.movImm(RCX, op.shamt);
+                else apply(X86_LOAD, RCX, op.rs);
+                if (op.ALU_src) x.movImm(RAX, op.imm);
+                else apply(X86_LOAD, RAX, op.rt);
+                switch (op.ALU_control) {
+                    case 0: x.regReg(X86_AND, RAX, RCX); break;
+                    case 1: x.regReg(X86_OR, RAX, RCX); break;
+                    case 3: x.shiftCl(EXT_SHL, RAX); break;
+                    case 4: x.shiftCl(EXT_SHR, RAX); break;
+                    case 5: x.shiftImm(EXT_SHL, RAX, 16); break;
+                    case 6: x.regReg(X86_SUB, RCX, RAX); x.regReg(X86_LOAD, RAX, RCX); break;
+                    case 7: x.regReg(X86_CMP, RCX, RAX); x.setLessEax(); break;
+                    case 12: x.regReg(X86_OR, RAX, RCX); x.notReg(RAX); break;
+                    default: x.regReg(X86_ADD, RAX, RCX); break;
+                }
+                if (op.reg_write) assign(op.write_reg, RAX);
+                break;
+
+            case OP_MULDIV: {
+                // Done in 64 bits: the product, or the quotient of the (sign-
+                // or zero-extended) operands, ends up in rax and HI in rcx. A
+                // divide needs rdx, which may hold a guest register, so it is
+                // saved around it; a zero divisor divides by 1 as in the ALU
+                bool is_signed = op.ALU_control == 8 || op.ALU_control == 10;
+                apply(X86_LOAD, RAX, op.rs);
+                apply(X86_LOAD, RCX, op.rt);
+                if (op.ALU_control >= 10) {
+                    x.regReg(X86_TEST, RCX, RCX);
+                    uint8_t *nonzero = x.jcc(CC_NE);
+                    x.movImm(RCX, 1);
+                    X86Emitter::link(nonzero, x.pos());
+                }
+                if (is_signed) {
+                    x.signExtend(RAX, RAX);
+                    x.signExtend(RCX, RCX);
+                }
+                if (op.ALU_control < 10) {
+                    x.multiply(RAX, RCX, true);
+                    x.regReg(X86_LOAD, RCX, RAX, true);
+                    x.shiftImm(EXT_SHR, RCX, 32, true);
+                } else {
+                    x.push(RDX);
+                    if (is_signed) x.signExtendRax();
+                    else x.regReg(X86_XOR, RDX, RDX);
+                    x.divide(is_signed, RCX, true);
+                    x.regReg(X86_LOAD, RCX, RDX);
+                    x.pop(RDX);
+                }
+                assign(REG_LO, RAX);
+                assign(REG_HI, RCX);
+                break;
+            }
+
+            case OP_LW:
+            case OP_LOAD_MASKED:
+            {
+                int dst = host[op.write_reg] >= 0 ? host[op.write_reg] : RAX;
+                address(op, i, false);
+                x.regGuest(X86_LOAD, dst);
+                if (op.kind == OP_LOAD_MASKED) x.immediate(EXT_AND, dst, op.halfword ? 0xffff : 0xff);
+                if (dst == RAX) assign(op.write_reg, RAX);
+                break;
+            }
+
+            case OP_SW:
+            case OP_STORE_MASKED: {
+                int value = op.kind == OP_SW && host[op.rt] >= 0 ? host[op.rt] : RBP;
+                address(op, i, true);
+                if (op.kind == OP_SW) {
+                    if (value == RBP) apply(X86_LOAD, RBP, op.rt);
+                } else {
+                    // old ^ ((old ^ value) & mask) merges value into the low bits
+                    x.regGuest(X86_LOAD, RBP);
+                    apply(X86_XOR, RBP, op.rt);
+                    x.immediate(EXT_AND, RBP, op.halfword ? 0xffff : 0xff);
+                    x.regGuest(X86_XOR, RBP);
+                }
+                x.regGuest(X86_STORE, value);
+                x.immediate(EXT_CMP, RAX, end_pc & ~3u);
+                stubs.push_back({x.jcc(CC_BE), JIT_EXIT_STORE, op.pc + 4, (uint32_t)(count - i - 1), true});
+                break;
+            }
+
+            case OP_BEQ:
+            case OP_BNE: {
+                int taken = op.kind == OP_BEQ ? CC_E : CC_NE;
+                apply(X86_LOAD, RAX, op.rs);
+                apply(X86_CMP, RAX, op.rt);
+                if (op.target == pc) {
+                    x.jcc(taken, head);
+                    writeBack();
+                    chainTo(x.jmp(), op.pc + 4);
+                } else {
+                    writeBack();
+                    chainTo(x.jcc(taken), op.target);
+                    chainTo(x.jmp(), op.pc + 4);
+                }
+                break;
+            }
+
+            case OP_JAL:
+                x.movImm(RAX, op.pc + 8);
+                assign(31, RAX);
+                // fall through
+            case OP_J:
+                if (op.target == pc) {
+                    x.jmp(head);
+                } else {
+                    writeBack();
+                    chainTo(x.jmp(), op.target);
+                }
+                break;
+
+            case OP_JR:
+                apply(X86_LOAD, RAX, op.rs);
+                writeBack();
+                x.regReg(X86_XOR, RCX, RCX);
+                x.jmp(exit_stub);
+                break;
+
+            case OP_EXIT:
+                writeBack();
+                chainTo(x.jmp(), op.pc);
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    for (const Stub &stub : stubs) {
+        X86Emitter::link(stub.site, x.pos());
+        if (stub.reason == JIT_EXIT_STORE || stub.reason == JIT_EXIT_PAGE) {
+            x.regContext(X86_STORE, RAX, CONTEXT_FIELD(store_address));
+        }
+        if (stub.write_back) writeBack();
+        if (stub.refund) x.immediate(EXT_ADD, R13, stub.refund, true);
+        if (stub.reason != JIT_EXIT_CHAIN) x.storeContext(CONTEXT_FIELD(reason), stub.reason);
+        x.movImm(RAX, stub.pc);
+        if (stub.reason == JIT_EXIT_CHAIN) x.movImm64(RCX, (uint64_t)stub.site);
+        else x.regReg(X86_XOR, RCX, RCX);
+        x.jmp(exit_stub);
+    }
+
+    code_free = x.pos();
+    return entry;
+}
+
+uint64_t FunctionalSimulator::runNative(Registers &regfile, uint64_t max_insts) {
+    typedef void (*Enter)(JitContext *context, PagedMemory::Table *const *dir, uint8_t *block);
+    Enter enter = (Enter)code;
+
+    JitContext context;
+    for (int i = 0; i < NUM_REGS; i++) {
+        uint32_t unused;
+        regfile.access(i, 0, context.R[i], unused, 0, false, 0);
+    }
+    context.remaining = max_insts;
+    context.reason = JIT_EXIT_CHAIN;
+    context.patch = nullptr;
+    uint32_t pc = regfile.pc;
+
+    while (pc <= end_pc) {
+        if (native[pc/4] && native_start[pc/4] != pc) {
+            // Unaligned target aliasing a compiled block
+            flushNative();
+            context.patch = nullptr;
+        }
+        if (!native[pc/4]) {
+            if (code_free + JIT_BLOCK_RESERVE > code + JIT_BUFFER_SIZE) {
+                flushNative();
+                context.patch = nullptr;
+            }
+            native[pc/4] = compile(pc);
+            native_start[pc/4] = pc;
+        }
+        if (context.patch) X86Emitter::link(context.patch, native[pc/4]);
+
+        context.reason = JIT_EXIT_CHAIN;
+        enter(&context, memory->backing().directory(), native[pc/4]);
+        pc = context.pc;
+
+        if (context.reason == JIT_EXIT_STORE) {
+            memory->predecode.invalidate(context.store_address);
+            flushNative();
+            flush_pending = true;
+        } else if (context.reason == JIT_EXIT_PAGE) {
+            memory->backing().writablePage(context.store_address);
+        } else if (context.reason == JIT_EXIT_BUDGET) {
+            break;
+        }
+    }
+
+    for (int i = 0; i < NUM_REGS; i++) {
+        uint32_t unused;
+        regfile.access(0, 0, unused, unused, i, true, context.R[i]);
+    }
+    regfile.pc = pc;
+    uint64_t retired = max_insts - context.remaining;
+    if (context.reason == JIT_EXIT_BUDGET) {
+        // Finish the part of a block that still fits in the budget
+        retired += interpret(regfile, context.remaining);
+    }
+    return retired;
+}
+
+#else
+
+bool FunctionalSimulator::enableJit() { return false; }
+FunctionalSimulator::~FunctionalSimulator() {}
+void FunctionalSimulator::flushNative() {}
+uint8_t *FunctionalSimulator::compile(uint32_t) { return nullptr; }
+uint64_t FunctionalSimulator::runNative(Registers &regfile, uint64_t max_insts) { return interpret(regfile, max_insts); }
+
+#endif
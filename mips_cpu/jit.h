@@ -0,0 +1,220 @@
+#ifndef X86_EMITTER
+#define X86_EMITTER
+#include <cstdint>
+#include <cstring>
+
+// x86-64 register numbers as the instruction encoding uses them
+enum HostReg {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+// Opcodes of the "reg, r/m" forms (X86_STORE is "r/m, reg")
+enum HostOpcode {
+    X86_ADD = 0x03,
+    X86_OR = 0x0b,
+    X86_AND = 0x23,
+    X86_SUB = 0x2b,
+    X86_XOR = 0x33,
+    X86_CMP = 0x3b,
+    X86_TEST = 0x85,
+    X86_STORE = 0x89,
+    X86_LOAD = 0x8b
+};
+
+// /digit extensions of the immediate (0x81) and shift (0xc1, 0xd3) groups
+enum HostExtension {
+    EXT_ADD = 0, EXT_OR = 1, EXT_AND = 4, EXT_SUB = 5, EXT_CMP = 7,
+    EXT_SHL = 4, EXT_SHR = 5
+};
+
+// Condition codes for jcc
+enum HostCondition {
+    CC_B = 0x2, CC_E = 0x4, CC_NE = 0x5, CC_BE = 0x6
+};
+
+// Encoder for the few x86-64 instruction forms the block translator emits.
+// Operands are 32 bits wide unless `wide` is set. Memory operands are either
+// [rbx + disp] (the JIT context), [rcx] (a guest word, once the page tables
+// have been walked) or an indexed load of a page table entry. There is no
+// bounds checking; callers reserve enough room before emitting a block.
+class X86Emitter {
+    private:
+        uint8_t *cur;
+
+        void byte(uint8_t b) { *cur++ = b; }
+
+        void dword(uint32_t d) {
+            memcpy(cur, &d, 4);
+            cur += 4;
+        }
+
+        void rex(bool wide, int reg, int rm) {
+            uint8_t prefix = 0x40 | (wide << 3) | ((reg >> 3) << 2) | (rm >> 3);
+            if (prefix != 0x40) byte(prefix);
+        }
+
+        void modrm(int mod, int reg, int rm) { byte((mod << 6) | ((reg & 7) << 3) | (rm & 7)); }
+
+        // ModRM (and displacement) for [rbx + disp]
+        void context(int reg, int32_t disp) {
+            if (disp >= -128 && disp < 128) {
+                modrm(1, reg, RBX);
+                byte(disp);
+            } else {
+                modrm(2, reg, RBX);
+                dword(disp);
+            }
+        }
+
+    public:
+        X86Emitter(uint8_t *buffer) : cur(buffer) {}
+
+        uint8_t *pos() const { return cur; }
+
+        // op reg, rm
+        void regReg(uint8_t opcode, int reg, int rm, bool wide = false) {
+            rex(wide, reg, rm);
+            byte(opcode);
+            modrm(3, reg, rm);
+        }
+
+        // op reg, [rbx + disp]
+        void regContext(uint8_t opcode, int reg, int32_t disp, bool wide = false) {
+            rex(wide, reg, RBX);
+            byte(opcode);
+            context(reg, disp);
+        }
+
+        // op reg, [rcx]
+        void regGuest(uint8_t opcode, int reg) {
+            rex(false, reg, RCX);
+            byte(opcode);
+            modrm(0, reg, RCX);
+        }
+
+        // mov reg, qword [base + index*8 + disp]; base must not be rbp or
+        // r13 unless there is a displacement
+        void loadScaled(int reg, int base, int index, int32_t disp = 0) {
+            byte(0x48 | ((reg >> 3) << 2) | ((index >> 3) << 1) | (base >> 3));
+            byte(X86_LOAD);
+            modrm(disp ? 2 : 0, reg, 4);
+            byte((3 << 6) | ((index & 7) << 3) | (base & 7));
+            if (disp) dword(disp);
+        }
+
+        // op rm, imm32 (group 1)
+        void immediate(int ext, int rm, uint32_t imm, bool wide = false) {
+            rex(wide, 0, rm);
+            byte(0x81);
+            modrm(3, ext, rm);
+            dword(imm);
+        }
+
+        // mov dword [rbx + disp], imm32
+        void storeContext(int32_t disp, uint32_t imm) {
+            byte(0xc7);
+            context(0, disp);
+            dword(imm);
+        }
+
+        void movImm(int rm, uint32_t imm) {
+            rex(false, 0, rm);
+            byte(0xb8 + (rm & 7));
+            dword(imm);
+        }
+
+        void movImm64(int rm, uint64_t imm) {
+            rex(true, 0, rm);
+            byte(0xb8 + (rm & 7));
+            memcpy(cur, &imm, 8);
+            cur += 8;
+        }
+
+        void shiftImm(int ext, int rm, uint8_t amount, bool wide = false) {
+            rex(wide, 0, rm);
+            byte(0xc1);
+            modrm(3, ext, rm);
+            byte(amount);
+        }
+
+        // Shift by cl
+        void shiftCl(int ext, int rm) {
+            rex(false, 0, rm);
+            byte(0xd3);
+            modrm(3, ext, rm);
+        }
+
+        // movsxd reg, rm32
+        void signExtend(int reg, int rm) {
+            rex(true, reg, rm);
+            byte(0x63);
+            modrm(3, reg, rm);
+        }
+
+        // imul reg, rm
+        void multiply(int reg, int rm, bool wide = false) {
+            rex(wide, reg, rm);
+            byte(0x0f);
+            byte(0xaf);
+            modrm(3, reg, rm);
+        }
+
+        // (r|e)dx:(r|e)ax / rm, quotient in rax and remainder in rdx
+        void divide(bool is_signed, int rm, bool wide = false) {
+            rex(wide, 0, rm);
+            byte(0xf7);
+            modrm(3, is_signed ? 7 : 6, rm);
+        }
+
+        // cqo: sign-extend rax into rdx
+        void signExtendRax() { byte(0x48); byte(0x99); }
+
+        void notReg(int rm) {
+            rex(false, 0, rm);
+            byte(0xf7);
+            modrm(3, 2, rm);
+        }
+
+        // eax = (signed) less-than flag of the last compare
+        void setLessEax() {
+            byte(0x0f); byte(0x9c); byte(0xc0);     // setl al
+            byte(0x0f); byte(0xb6); byte(0xc0);     // movzx eax, al
+        }
+
+        void push(int r) { rex(false, 0, r); byte(0x50 + (r & 7)); }
+        void pop(int r) { rex(false, 0, r); byte(0x58 + (r & 7)); }
+        void ret() { byte(0xc3); }
+
+        void jmpReg(int rm) {
+            rex(false, 0, rm);
+            byte(0xff);
+            modrm(3, 4, rm);
+        }
+
+        // Jumps with a rel32 displacement; both return the address of the
+        // displacement so it can be linked later
+        uint8_t *jcc(int condition, const uint8_t *target = nullptr) {
+            byte(0x0f);
+            byte(0x80 | condition);
+            uint8_t *site = cur;
+            dword(0);
+            if (target) link(site, target);
+            return site;
+        }
+
+        uint8_t *jmp(const uint8_t *target = nullptr) {
+            byte(0xe9);
+            uint8_t *site = cur;
+            dword(0);
+            if (target) link(site, target);
+            return site;
+        }
+
+        // Points the rel32 at site to target
+        static void link(uint8_t *site, const uint8_t *target) {
+            int32_t rel = (int32_t)(target - (site + 4));
+            memcpy(site, &rel, 4);
+        }
+};
+#endif
@@ -0,0 +1,122 @@
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "loader.h"
+using namespace std;
+
+bool readProgram(const char *path, ProgramImage &image)
+{
+  /* Map the whole executable; segments point into the mapping. */
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+      cout << "Failed to open executable binary: " << string(path) << "\n";
+      return false;
+  }
+  struct stat st;
+  void *mapping = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (mapping == MAP_FAILED) {
+      cout << "Failed to map executable binary: " << string(path) << "\n";
+      return false;
+  }
+  size_t size = st.st_size;
+  image.file = shared_ptr<const uint8_t>((const uint8_t *)mapping,
+                                         [size](const uint8_t *p) { munmap((void *)p, size); });
+  const uint8_t *base = image.file.get();
+
+  /* Verify executable header. */
+  Elf32_Ehdr ehdr;
+  if (size < sizeof(ehdr) || memcmp(base, "\177ELF\1\1\1", 7)) {
+     cout << "Error in ELF header\n";
+     return false;
+  }
+  memcpy(&ehdr, base, sizeof(ehdr));
+  if (ehdr.e_phentsize != sizeof(Elf32_Phdr) || ehdr.e_phoff > size ||
+      ehdr.e_phnum > (size - ehdr.e_phoff) / sizeof(Elf32_Phdr)) {
+      cout << "Error in program headers\n";
+      return false;
+  }
+
+  /* Collect the loadable segments. */
+  image.segments.clear();
+  image.entry = ehdr.e_entry;
+  image.text_base = image.text_size = 0;
+  bool found_text = false;
+  for (int i = 0; i < ehdr.e_phnum; i++) {
+      Elf32_Phdr phdr;
+      memcpy(&phdr, base + ehdr.e_phoff + i * sizeof(phdr), sizeof(phdr));
+      if (phdr.p_type != PT_LOAD || phdr.p_memsz == 0) {
+          continue;
+      }
+      if (phdr.p_offset > size || phdr.p_filesz > size - phdr.p_offset || phdr.p_filesz > phdr.p_memsz ||
+          phdr.p_vaddr + (uint64_t)phdr.p_memsz > (1ull << 32)) {
+          cout << "Could not populate memory from segment at " << phdr.p_vaddr <<
+                  ": offset=" << phdr.p_offset << ", file size=" << phdr.p_filesz <<
+                  ", memory size=" << phdr.p_memsz << "\n";
+          return false;
+      }
+      image.segments.push_back({phdr.p_vaddr, phdr.p_filesz, phdr.p_memsz, base + phdr.p_offset});
+      if ((phdr.p_flags & PF_X) && !found_text && image.entry - phdr.p_vaddr < phdr.p_filesz) {
+          image.text_base = phdr.p_vaddr;
+          image.text_size = phdr.p_filesz & ~3u;
+          found_text = true;
+      }
+  }
+
+  if (!found_text) {
+      cout << "No executable segment holds the entry point " << image.entry << " in " << string(path) << "\n";
+      return false;
+  }
+
+  /* The segment may carry read-only data after the code; where section
+     headers are present, the run ends at the end of the code itself. */
+  if (ehdr.e_shentsize == sizeof(Elf32_Shdr) && ehdr.e_shoff <= size &&
+      ehdr.e_shnum <= (size - ehdr.e_shoff) / sizeof(Elf32_Shdr)) {
+      for (int i = 0; i < ehdr.e_shnum; i++) {
+          Elf32_Shdr shdr;
+          memcpy(&shdr, base + ehdr.e_shoff + i * sizeof(shdr), sizeof(shdr));
+          if ((shdr.sh_flags & SHF_EXECINSTR) && image.entry - shdr.sh_addr < shdr.sh_size &&
+              shdr.sh_addr - image.text_base + (uint64_t)shdr.sh_size <= image.text_size) {
+              image.text_base = shdr.sh_addr;
+              image.text_size = shdr.sh_size & ~3u;
+              break;
+          }
+      }
+  }
+  return true;
+}
+
+uint32_t installProgram(const ProgramImage &image, Memory &memory)
+{
+  PagedMemory &mem = memory.backing();
+  for (const ProgramImage::Segment &seg : image.segments) {
+      uint32_t file_end = seg.vaddr + seg.file_size;
+      /* Pages lined up with the file that it fills completely are borrowed
+         from the mapping; the rest are copied, around zeroes past file_end. */
+      bool aligned = (((uintptr_t)seg.data - seg.vaddr) & ((1 << MEM_PAGE_BITS) - 1)) == 0;
+      uint64_t last = (uint64_t)seg.vaddr + seg.mem_size;
+      for (uint64_t page = seg.vaddr & ~((1u << MEM_PAGE_BITS) - 1); page < last; page += 1 << MEM_PAGE_BITS) {
+          uint64_t from = max<uint64_t>(page, seg.vaddr);
+          uint64_t to = min<uint64_t>(page + (1 << MEM_PAGE_BITS), file_end);
+          if (aligned && from == page && to == page + (1 << MEM_PAGE_BITS)) {
+              mem.borrowPage(page, (const uint32_t *)(seg.data + (page - seg.vaddr)));
+          } else if (from < to) {
+              memcpy((uint8_t *)mem.writablePage(page) + (from - page), seg.data + (from - seg.vaddr), to - from);
+          }
+      }
+  }
+
+  memory.predecode.setRegion(image.text_base, image.text_size);
+  for (uint32_t j = 0; j < image.text_size; j += 4) {
+      memory.predecode.fill(image.text_base + j, mem.load(image.text_base + j));
+  }
+  return image.text_base + image.text_size;
+}
@@ -0,0 +1,36 @@
+#ifndef LOADER
+#define LOADER
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "memory.h"
+
+// A benchmark's loadable segments, mapped from the ELF file once and then
+// installed into as many Memory instances as need it (the sweep runner
+// shares one per benchmark). Memory borrows whole pages straight from the
+// mapping, so the image has to outlive every Memory it was installed into
+struct ProgramImage {
+    struct Segment {
+        uint32_t vaddr;
+        uint32_t file_size;     // bytes taken from the file; the rest of
+        uint32_t mem_size;      // mem_size (bss) reads as zero
+        const uint8_t *data;    // the segment's bytes in the mapping
+    };
+
+    std::shared_ptr<const uint8_t> file;    // read-only mapping, unmapped with the last copy
+    std::vector<Segment> segments;          // every PT_LOAD, in file order
+    uint32_t entry;
+    uint32_t text_base;     // the executable segment holding the entry point,
+    uint32_t text_size;     // which gets decoded ahead
+};
+
+// Maps an ELF32 little-endian executable and records its PT_LOAD segments.
+// Prints the reason and returns false if the file is unreadable, malformed
+// or its entry point is not in an executable segment
+bool readProgram(const char *path, ProgramImage &image);
+
+// Installs every segment into memory, copy-on-write, and decodes the text
+// into its decode cache. Returns end_pc, the end of the text the run loops
+// compare the PC against
+uint32_t installProgram(const ProgramImage &image, Memory &memory);
+#endif
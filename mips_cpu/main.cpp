@@ -3,69 +3,125 @@
 #include <cstdlib>
 #include <string>
 #include <cstring>
-#include <elf.h>
 #include <sys/types.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/mman.h>
 #include <errno.h>
 #include <getopt.h>
+#include <cmath>
 #include "processor.h"
+#include "loader.h"
 
 using namespace std;
 
+enum OutputMode {
+    OUTPUT_EVERY_CYCLE,     // full register file after every cycle
+    OUTPUT_QUIET,           // final cycle count only
+    OUTPUT_FINAL_STATE,     // register file at halt
+    OUTPUT_DELTA            // changed registers only, tagged with the cycle
+};
+
 extern void single_cycle_main_loop(Registers &reg_file, Memory &memory, uint32_t end_pc);
 extern void pipelined_main_loop(Registers &reg_file, Memory &memory, uint32_t end_pc, int width);
 extern void processor_main_loop(Registers &reg_file, Memory &memory, uint32_t end_pc, int width);
+extern int run_sweep(int argc, char *argv[]);
 
-/* Load Binary. */
-uint32_t load(char *bmk, Memory &memory)
+/* Load Binary. Memory borrows pages from the image, so it has to stay
+   around until the run ends; starts the program at its entry point. */
+uint32_t load(char *bmk, Memory &memory, Processor &processor, ProgramImage &image, uint32_t stack_top)
 {
-  Elf32_Ehdr ehdr;
-  Elf32_Shdr shdr;
-
-  /* Open binary executable. */
-  FILE *binary, *binary_copy;
-  binary = fopen(bmk, "r");
-  if (!binary) {
-      cout << "Failed to open executable binary: " << string(optarg) << "\n";
+  if (!readProgram(bmk, image)) {
       return 0;
   }
+  uint32_t end_pc = installProgram(image, memory);
+  processor.start(image.entry, stack_top);
+  return end_pc;
+}
 
-  /* Read and verify executable header. */
-  int num_read = fread(&ehdr, 1, sizeof(ehdr), binary);
-  if ((num_read != sizeof(ehdr)) || memcmp(ehdr.e_ident, "\177ELF\1\1\1", 7)) {
-     cout << "Error in ELF header\n";
-     return 0;
-  }
+// Sampled run: fast-forward with functional warming, then a detailed window
+// of warmup + window instructions on the out-of-order core, once per
+// interval instructions. Reports the mean CPI of the windows, its 95%
+// confidence interval and the extrapolated cycle count.
+void run_sampled(Processor &processor, uint32_t end_pc, uint64_t interval, uint64_t window, uint64_t warmup,
+                 OutputMode output_mode, BufferedWriter &out)
+{
+    uint64_t instructions = 0;
+    uint64_t detailed = 0;
+    uint64_t samples = 0;
+    double sum = 0;
+    double sum_squares = 0;
 
-  /* Read section headers. */
-  fseek(binary, ehdr.e_shoff, SEEK_SET);
-  for (int i = 0; i < ehdr.e_shnum; i++) {
-      num_read = fread(&shdr, sizeof(shdr), 1, binary);
-      if (num_read != 1) {
-          cout << "Error in section header: " << num_read << " shdr=" << shdr.sh_addr << "\n";
-          break;
-      }
-      uint32_t word, dummy_word;
-      if ((shdr.sh_flags & SHF_EXECINSTR) != 0 && shdr.sh_addr == 0) { /* Text section -- we hardcoded this to zero during compilation. */
-          binary_copy = fopen(bmk, "r");
-          fseek(binary_copy, shdr.sh_offset, SEEK_SET);
-          for (int j = 0; j < (int)shdr.sh_size; j += 4) {
-              num_read = fread(&word, 1, 4, binary_copy);
-              if (num_read != 4) {
-                  cout << "Could not populate memory from section: " << shdr.sh_addr <<
-                          ": bytes read=" << j + num_read << ", section header size=" << shdr.sh_size << "\n";
-                  return 0;
-              }
-              memory.access((uint32_t)shdr.sh_addr+j, dummy_word, word, false, true);
-          }
-          fclose(binary_copy);
-          return shdr.sh_size;
-      }
-  }
+    while (processor.getPC() <= end_pc) {
+        instructions += processor.fastForward(end_pc, interval - window - warmup);
+        if (processor.getPC() > end_pc) {
+            break;
+        }
+        Processor::DetailedWindow sample = processor.runDetailed(end_pc, warmup, window);
+        instructions += sample.committed;
+        detailed += sample.committed;
+        if (sample.measured >= window) {
+            double cpi = (double)sample.cycles / sample.measured;
+            sum += cpi;
+            sum_squares += cpi * cpi;
+            samples++;
+        }
+        if (sample.finished) {
+            break;
+        }
+    }
 
-  return 0;
+    double cpi = samples ? sum / samples : 0;
+    double interval95 = 0;
+    if (samples > 1) {
+        double variance = (sum_squares - samples * cpi * cpi) / (samples - 1);
+        interval95 = 1.96 * sqrt(variance > 0 ? variance / samples : 0);
+    }
+
+    if (output_mode == OUTPUT_FINAL_STATE) {
+        processor.printRegFile(out);
+    }
+    if (output_mode != OUTPUT_QUIET) {
+        out << "Samples: " << samples << "\n";
+        out << "Instructions: " << instructions << " (" << detailed << " detailed)\n";
+        out << "CPI: ";
+        out.putFixed(cpi, 4);
+        out << " +/- ";
+        out.putFixed(interval95, 4);
+        out << " (95% confidence)\n";
+    }
+    out << (uint64_t)llround(cpi * instructions) << "\n";
+}
+
+// Checkpoint file: a "RUN " section with the end PC and the cycle and
+// instruction counts so far, followed by the processor state
+bool save_checkpoint(Processor &processor, const char *path, uint32_t end_pc, uint64_t cycles, uint64_t instructions)
+{
+    CheckpointWriter file(path);
+    file.section("RUN ");
+    file.put(end_pc);
+    file.put(cycles);
+    file.put(instructions);
+    processor.save(file);
+    if (!file.close()) {
+        cout << "Failed to write checkpoint: " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool restore_checkpoint(Processor &processor, const char *path, uint32_t &end_pc, uint64_t &cycles, uint64_t &instructions)
+{
+    CheckpointReader file(path);
+    file.section("RUN ");
+    end_pc = file.get<uint32_t>();
+    cycles = file.get<uint64_t>();
+    instructions = file.get<uint64_t>();
+    if (!file.good() || !processor.restore(file)) {
+        cout << "Not a valid checkpoint for this build: " << path << "\n";
+        return false;
+    }
+    return true;
 }
 
 void print_help()
@@ -79,10 +135,71 @@ void print_help()
             "-O2                                  Optimization Level 2 (custom optimization TBD; includes O1)\n"
             "-O3                                  Optimization Level 3 (custom optimization TBD; includes O2)\n"
             "-O4                                  Optimization Level 4 (custom optimization TBD; includes O3)\n"
-            "                                     Defaults to -O0\n";
+            "                                     Defaults to -O0\n"
+            "--width=<N>                          Superscalar width of the -O2+ core (1, 2, 4, 5, 6 or 8)\n"
+            "                                     Defaults to 1\n"
+            "--l1-size=<bytes>                    L1 cache size (default 32768; 8-way, 64-byte lines)\n"
+            "--l2-size=<bytes>                    L2 cache size (default 262144)\n"
+            "--l1-repl=<policy>                   L1 replacement policy: lru (default), plru, srrip, brrip, dip\n"
+            "                                     or random[:<seed>]\n"
+            "--l2-repl=<policy>                   L2 replacement policy (same choices)\n"
+            "--mshrs=<N>                          Outstanding cache lines the -O2+ core may have (default 16)\n"
+            "--issue=<policy>                     Which ready instruction the -O2+ core issues first: oldest\n"
+            "                                     (default), index (lowest queue slot), branch-first or load-first\n"
+            "--bpred=<spec>                       Branch direction predictor of the -O2+ core: bimodal[:<entries>]\n"
+            "                                     (default, 1024), gshare[:<entries>[:<history bits>]],\n"
+            "                                     tournament[:<entries>], tage[:<entries per table>] or\n"
+            "                                     perceptron[:<perceptrons>[:<history bits>]]\n"
+            "--ras=<N>                            Return address stack entries of the -O2+ core (default 16; 0\n"
+            "                                     predicts returns with the BTB alone)\n"
+            "--indirect=<N>                       Entries in the -O2+ core's path-indexed target cache for jr\n"
+            "                                     through registers other than $31 (default 256, a power of two;\n"
+            "                                     0 leaves them to the BTB)\n"
+            "--loop=<N>                           Entries in the -O2+ core's loop predictor, which learns trip\n"
+            "                                     counts and overrides --bpred on loop exits (default 64, a\n"
+            "                                     power of two from 4 to 4096; 0 for none)\n"
+            "--ports=<list>                       Issue ports of the -O2+ core, each the '+'-joined unit classes\n"
+            "                                     it serves (alu, branch, agu, muldiv, any), e.g.\n"
+            "                                     alu+branch,alu+muldiv,agu. Defaults to --width ports of any\n"
+            "--fu-latency=<list>                  <class or op>:<cycles> pairs; ops are and, or, add, sll, srl, lui,\n"
+            "                                     sub, slt, mult, multu, div, divu, nor (default 1 cycle, muldiv 4,\n"
+            "                                     div and divu 32)\n"
+            "--unpipelined=<list>                 Unit classes or ops that take one instruction at a time (default\n"
+            "                                     div,divu; none for all pipelined)\n"
+            "--result-buses=<N>                   Results the -O2+ core can broadcast per cycle (default: no limit)\n"
+            "--stack-top=<addr>                   Initial $sp (R29); by default it starts at 0 like every other\n"
+            "                                     register, as the benchmarks expect\n"
+            "--no-idle-skip                       Simulate cycles the -O2+ core spends waiting on memory one by\n"
+            "                                     one (the counts are the same; for checking the fast path)\n"
+            "Output (defaults to the register file at every cycle):\n"
+            "--quiet                              Print only the final cycle count\n"
+            "--final-state                        Print the register file once, at halt\n"
+            "--delta                              Print only registers that changed, with the cycle number\n"
+            "--stats                              Print cache and branch prediction statistics to stderr at the end\n"
+            "                                     of a timed run\n"
+            "--functional                         Run untimed: print the register file at halt (unless --quiet)\n"
+            "                                     and the number of instructions retired instead of cycles\n"
+            "--jit                                Like --functional, but translates blocks to x86-64 code\n"
+            "Sampling (-O2 and above):\n"
+            "--sample=<N>                         Start a detailed window every N instructions and fast-forward\n"
+            "                                     with cache/predictor warming in between. Prints the sampled\n"
+            "                                     CPI with a 95% confidence interval and the estimated cycles\n"
+            "--sample-window=<N>                  Instructions measured per window (default 1000)\n"
+            "--sample-warmup=<N>                  Detailed instructions run before each window (default 2000)\n"
+            "Checkpoints:\n"
+            "--save-checkpoint-at=<N>[c|i]        Stop after N cycles (c, the default) or N instructions (i) and\n"
+            "                                     save the simulator state; functional runs count instructions\n"
+            "--checkpoint-file=<path>             Where to save it (default checkpoint.ckpt)\n"
+            "--restore=<path>                     Continue from a saved checkpoint instead of --bmk; the counts\n"
+            "                                     carry on from the saved ones\n"
+            "Design-space sweeps: processor sweep --help\n";
 }
 
 int main(int argc, char *argv[]) {
+    if (argc > 1 && !strcmp(argv[1], "sweep")) {
+        return run_sweep(argc - 1, argv + 1);
+    }
+
     static struct option long_options[] = {
       {"bmk", required_argument, 0, 'b'},
       {"opt", optional_argument, 0, 'O'},
@@ -91,19 +208,70 @@ int main(int argc, char *argv[]) {
       {"opt2", optional_argument, 0, '2'},
       {"opt3", optional_argument, 0, '3'},
       {"opt4", optional_argument, 0, '4'},
+      {"width", required_argument, 0, 'w'},
+      {"quiet", no_argument, 0, 'q'},
+      {"final-state", no_argument, 0, 'f'},
+      {"delta", no_argument, 0, 'd'},
+      {"functional", no_argument, 0, 'F'},
+      {"jit", no_argument, 0, 'J'},
+      {"sample", required_argument, 0, 'S'},
+      {"sample-window", required_argument, 0, 'L'},
+      {"sample-warmup", required_argument, 0, 'A'},
+      {"save-checkpoint-at", required_argument, 0, 'C'},
+      {"checkpoint-file", required_argument, 0, 'P'},
+      {"restore", required_argument, 0, 'R'},
+      {"l1-size", required_argument, 0, 'I'},
+      {"l2-size", required_argument, 0, 'K'},
+      {"no-idle-skip", no_argument, 0, 'N'},
+      {"l1-repl", required_argument, 0, 'X'},
+      {"l2-repl", required_argument, 0, 'Y'},
+      {"stats", no_argument, 0, 's'},
+      {"mshrs", required_argument, 0, 'M'},
+      {"stack-top", required_argument, 0, 'T'},
+      {"issue", required_argument, 0, 'Z'},
+      {"bpred", required_argument, 0, 'B'},
+      {"ras", required_argument, 0, 'a'},
+      {"indirect", required_argument, 0, 'i'},
+      {"loop", required_argument, 0, 'o'},
+      {"ports", required_argument, 0, 'p'},
+      {"fu-latency", required_argument, 0, 'l'},
+      {"unpipelined", required_argument, 0, 'u'},
+      {"result-buses", required_argument, 0, 'r'},
       {"help", no_argument, 0, 'h'}
     };
     int option_index = 0;
     bool initialized = false;
 
-    Memory memory;
-    Processor processor(&memory); 
-    uint32_t end_pc = 0;
-
+    const char *bmk = nullptr;
     int optLevel = 0;
+    int width = 1;
+    OutputMode output_mode = OUTPUT_EVERY_CYCLE;
+    bool functional = false;
+    bool jit = false;
+    uint64_t sample_interval = 0;
+    uint64_t sample_window = 1000;
+    uint64_t sample_warmup = 2000;
+    uint64_t save_at = 0;
+    bool save_by_instructions = false;
+    const char *checkpoint_file = "checkpoint.ckpt";
+    const char *restore_file = nullptr;
+    int l1_size = DEFAULT_L1_SIZE;
+    int l2_size = DEFAULT_L2_SIZE;
+    bool skip_idle = true;
+    const char *l1_repl = "lru";
+    const char *l2_repl = "lru";
+    bool stats = false;
+    int mshrs = DEFAULT_MSHRS;
+    uint32_t stack_top = 0;
+    IssuePolicy issue_policy = ISSUE_OLDEST;
+    const char *bpred = "bimodal";
+    long ras_depth = BranchPredictor::DEFAULT_RAS_DEPTH;
+    long indirect_entries = BranchPredictor::DEFAULT_INDIRECT_ENTRIES;
+    long loop_entries = BranchPredictor::DEFAULT_LOOP_ENTRIES;
+    FunctionalUnits units;
 
     while (true) {
-      char c = getopt_long(argc, argv, "b:O01234h", long_options, &option_index);
+      char c = getopt_long(argc, argv, "b:O01234w:h", long_options, &option_index);
       if (c == -1) {
           if (!initialized) {
               print_help();
@@ -117,7 +285,7 @@ int main(int argc, char *argv[]) {
               print_help();
               exit(0);
           case 'b':
-              end_pc = load(optarg, memory);
+              bmk = optarg;
               break;
           case 'O':
               break;
@@ -127,21 +295,275 @@ int main(int argc, char *argv[]) {
           case '3':
           case '4':
               optLevel = c-'0';
-              processor.initialize(optLevel);
               initialized = 1;
               break;
+          case 'w':
+              width = atoi(optarg);
+              break;
+          case 'q':
+              output_mode = OUTPUT_QUIET;
+              break;
+          case 'f':
+              output_mode = OUTPUT_FINAL_STATE;
+              break;
+          case 'd':
+              output_mode = OUTPUT_DELTA;
+              break;
+          case 'F':
+              functional = true;
+              initialized = 1;
+              break;
+          case 'J':
+              functional = true;
+              jit = true;
+              initialized = 1;
+              break;
+          case 'S':
+              sample_interval = strtoull(optarg, nullptr, 10);
+              break;
+          case 'L':
+              sample_window = strtoull(optarg, nullptr, 10);
+              break;
+          case 'A':
+              sample_warmup = strtoull(optarg, nullptr, 10);
+              break;
+          case 'C': {
+              char *unit;
+              save_at = strtoull(optarg, &unit, 10);
+              save_by_instructions = *unit == 'i';
+              if (!save_at || (*unit && strcmp(unit, "i") && strcmp(unit, "c"))) {
+                  cout << "--save-checkpoint-at takes a positive count with an optional c or i suffix\n";
+                  exit(1);
+              }
+              break;
+          }
+          case 'P':
+              checkpoint_file = optarg;
+              break;
+          case 'R':
+              restore_file = optarg;
+              initialized = 1;
+              break;
+          case 'I':
+              l1_size = atoi(optarg);
+              break;
+          case 'K':
+              l2_size = atoi(optarg);
+              break;
+          case 'N':
+              skip_idle = false;
+              break;
+          case 'X':
+              l1_repl = optarg;
+              break;
+          case 'Y':
+              l2_repl = optarg;
+              break;
+          case 's':
+              stats = true;
+              break;
+          case 'M':
+              mshrs = atoi(optarg);
+              break;
+          case 'T':
+              stack_top = strtoul(optarg, nullptr, 0);
+              break;
+          case 'Z':
+              if (!Processor::issuePolicyByName(optarg, issue_policy)) {
+                  cout << "Unknown issue policy: " << optarg << "\n";
+                  exit(1);
+              }
+              break;
+          case 'B':
+              if (!BranchPredictor::valid(optarg)) {
+                  cout << "Unknown branch predictor: " << optarg << "\n";
+                  exit(1);
+              }
+              bpred = optarg;
+              break;
+          case 'a':
+              ras_depth = atol(optarg);
+              if (ras_depth < 0 || ras_depth > (long)BranchPredictor::MAX_RAS_DEPTH) {
+                  cout << "--ras takes a depth from 0 to " << BranchPredictor::MAX_RAS_DEPTH << "\n";
+                  exit(1);
+              }
+              break;
+          case 'i':
+              indirect_entries = atol(optarg);
+              if (!BranchPredictor::validIndirectEntries(indirect_entries)) {
+                  cout << "--indirect takes 0 or a power of two up to " << BranchPredictor::MAX_INDIRECT_ENTRIES << "\n";
+                  exit(1);
+              }
+              break;
+          case 'o':
+              loop_entries = atol(optarg);
+              if (!LoopPredictor::validSize(loop_entries)) {
+                  cout << "--loop takes 0 or a power of two from 4 to 4096\n";
+                  exit(1);
+              }
+              break;
+          case 'p':
+          case 'l':
+          case 'u':
+              if (!(c == 'p' ? units.setPorts(optarg) : c == 'l' ? units.setLatencies(optarg) : units.setUnpipelined(optarg))) {
+                  cout << "Bad functional unit list: " << optarg << "\n";
+                  if (c == 'p') cout << "(every class, alu, branch, agu and muldiv, needs a port)\n";
+                  exit(1);
+              }
+              break;
+          case 'r':
+              units.result_buses = atoi(optarg);
+              if (units.result_buses < 0) {
+                  cout << "--result-buses takes a count, or 0 for no limit\n";
+                  exit(1);
+              }
+              break;
       }
     }
 
+    if (!Memory::validCacheSizes(l1_size, l2_size)) {
+        cout << "Cache sizes must be powers of two of at least " << CACHE_LINE_SIZE * CACHE_ASSOC <<
+                " bytes, with L2 no smaller than L1\n";
+        exit(1);
+    }
+    for (const char *repl : {l1_repl, l2_repl}) {
+        if (!Memory::validReplacementPolicy(repl)) {
+            cout << "Unknown replacement policy: " << repl << "\n";
+            exit(1);
+        }
+    }
+    if (mshrs < 1 || mshrs > MAX_MSHRS) {
+        cout << "--mshrs takes a count from 1 to " << MAX_MSHRS << "\n";
+        exit(1);
+    }
+    ProgramImage image;     // declared first: memory borrows its pages
+    Memory memory(l1_size, l2_size, l1_repl, l2_repl, mshrs);
+    Processor processor(&memory);
+    processor.initialize(optLevel);
+    processor.setIssuePolicy(issue_policy);
+    processor.setBranchPredictor(bpred, ras_depth, indirect_entries, loop_entries);
+    processor.setFunctionalUnits(units);
+    uint32_t end_pc = bmk ? load((char *)bmk, memory, processor, image, stack_top) : 0;
+
+    if (!processor.setWidth(width)) {
+        cout << "Unsupported width: " << width << "\n";
+        print_help();
+        exit(1);
+    }
+
     memory.setOptLevel(optLevel);
-    uint64_t num_cycles = 0;
+
+    // All run output goes through one buffer that is only flushed at the end
+    BufferedWriter out;
+
+    if (jit && !processor.enableJit()) {
+        cerr << "No native backend on this host; interpreting instead\n";
+    }
+
+    uint64_t start_cycles = 0;
+    uint64_t start_instructions = 0;
+    if (restore_file && !restore_checkpoint(processor, restore_file, end_pc, start_cycles, start_instructions)) {
+        exit(1);
+    }
+    if (save_at && (sample_interval || optLevel == 1)) {
+        cout << "--save-checkpoint-at does not work with --sample or -O1\n";
+        exit(1);
+    }
+
+    if (sample_interval) {
+        if (optLevel < 2 || functional || !sample_window || sample_interval <= sample_window + sample_warmup) {
+            cout << "--sample needs -O2 or above and an interval longer than the window plus warm-up\n";
+            exit(1);
+        }
+        run_sampled(processor, end_pc, sample_interval, sample_window, sample_warmup, output_mode, out);
+        out.flush();
+        return 0;
+    }
+
+    if (functional) {
+        // The functional engine reads and writes memory behind the caches
+        memory.emptyCaches();
+        uint64_t retired = start_instructions;
+        if (save_at) {
+            if (save_at > retired) {
+                retired += processor.runFunctional(end_pc, save_at - retired);
+            }
+            if (processor.getPC() <= end_pc &&
+                !save_checkpoint(processor, checkpoint_file, end_pc, 0, retired)) {
+                exit(1);
+            }
+        } else {
+            retired += processor.runFunctional(end_pc);
+        }
+        if (output_mode != OUTPUT_QUIET) {
+            processor.printRegFile(out);
+        }
+        out << retired << "\n";
+        out.flush();
+        return 0;
+    }
+    int32_t last_values[32] = {0};
+    if (output_mode == OUTPUT_EVERY_CYCLE) {
+        processor.setTrace(&out);
+    }
+
+    // A checkpoint saved at -O0 should carry warm caches and predictor tables
+    if (save_at && optLevel == 0) {
+        processor.setWarming(true);
+    }
+
+    // Every-cycle output has to show the idle cycles too
+    skip_idle = skip_idle && output_mode != OUTPUT_EVERY_CYCLE;
+    uint64_t num_cycles = start_cycles;
+    bool draining = false;
+    auto instructions = [&]() {
+        // The single-cycle core retires one instruction per cycle
+        return start_instructions + (optLevel == 0 ? num_cycles - start_cycles : processor.committedInstructions());
+    };
     while (processor.getPC() <= end_pc) {
         processor.advance();
-        // cout << "\nCYCLE " << num_cycles << "\n";
-        // processor.printRegFile();
+        if (output_mode == OUTPUT_EVERY_CYCLE) {
+            out << "CYCLE " << num_cycles << "\n";
+            processor.printRegFile(out);
+        } else if (output_mode == OUTPUT_DELTA) {
+            processor.printRegFileChanges(out, num_cycles, last_values);
+        }
         num_cycles++;
+
+        if (skip_idle) {
+            // Never past a cycle count the checkpoint is waiting for
+            uint64_t limit = UINT64_MAX;
+            if (save_at && !save_by_instructions && !draining) {
+                limit = save_at > num_cycles ? save_at - num_cycles : 0;
+            }
+            num_cycles += processor.skipIdleCycles(limit);
+        }
+
+        if (save_at && !draining && (save_by_instructions ? instructions() : num_cycles) >= save_at) {
+            processor.beginDrain();
+            draining = true;
+        }
+        if (draining && processor.drained()) {
+            processor.endDrain();
+            if (processor.getPC() <= end_pc) {
+                if (!save_checkpoint(processor, checkpoint_file, end_pc, num_cycles, instructions())) {
+                    exit(1);
+                }
+                break;
+            }
+        }
+    }
+    if (output_mode == OUTPUT_FINAL_STATE) {
+        processor.printRegFile(out);
+    }
+    out << num_cycles << "\n";
+    out.flush();
+    if (stats) {
+        memory.printStats(cerr);
+        if (optLevel >= 2) {
+            processor.printBranchStats(cerr);
+        }
     }
-    cout << num_cycles;
 
     // cout << "\nCompleted execution in " << (double)num_cycles*(optLevel ? 1 : 125)*0.5 << " nanoseconds.\n";
 }
@@ -2,6 +2,8 @@
 #include <cstdint>
 #include <iostream>
 #include <cmath>
+#include <algorithm>
+#include <iomanip>
 #include "memory.h"
 
 // Disable debug by ensuring ENABLE_DEBUG is not defined
@@ -18,105 +20,50 @@ using namespace std;
 // Check if hit in the cache
 bool Cache::isHit(uint32_t address, uint32_t &loc) {
     int idx = getIndex(address);
-    int tag = getTag(address);
-    DEBUG(cout << name << " In isHIT: " << " tag: " << tag << endl;)
-
-    for (int w=0; w<assoc; w++) {
-        DEBUG(cout << "way: " << w << " line tag: " << line[idx*assoc+w].tag << " replBits: " << (int)line[idx*assoc+w].replBits << endl;)
-        if (line[idx*assoc+w].valid && line[idx*assoc+w].tag == tag) {
-            DEBUG(cout << name << " isHit is true" << endl;)
-            loc = idx*assoc+w;
-            updateReplacementBits(idx, w);
-            return true;
-        }
-    }
-    return false;
-}
-
-// Update replacement bits after access
-void Cache::updateReplacementBits(int idx, int way) {
-    uint8_t curRepl = line[idx*assoc+way].replBits;
-    DEBUG(cout << name << " curRepl: " << (int)curRepl << endl;)
-    for (int w=0; w<assoc; w++) {
-        if (line[idx*assoc+w].valid && line[idx*assoc+w].replBits > curRepl) {
-            DEBUG(cout << "way " << w << " replBits is: " << (int)line[idx*assoc+w].replBits << " will now decrease by 1" << endl;)
-            line[idx*assoc+w].replBits--;
-        }
+    int w = findWay(idx, getTag(address));
+    DEBUG(cout << name << " In isHIT: " << " tag: " << getTag(address) << " way: " << w << endl;)
+    if (w < 0) {
+        return false;
     }
-    line[idx*assoc+way].replBits = assoc-1;
+    loc = idx*assoc+w;
+    policy->touch(idx, w, &tags[idx*assoc]);
+    return true;
 }
 
-// Read a word from this cache
-bool Cache::read(uint32_t address, uint32_t &read_data, MSHREntry &entry) {
+// Looks an arriving request's line up
+int Cache::probe(uint32_t address) {
     uint32_t loc = 0;
-    int missCountdown = name == "L1"? entry.L1_penality : entry.L2_penality;
-    if (missCountdown) {
-        DEBUG(cout << name + " Cache (read miss) at address " << std::hex << address << std::dec << ": " << missCountdown << " cycles remaining to be serviced\n");
-        missCountdown--;
-        if (name == "L1"){
-            entry.L1_penality = missCountdown;
-        }else{
-            entry.L2_penality = missCountdown;
-        }
-        return false;
-    }
-    // Once miss penalty is completely paid, isHit should return true
     if (!isHit(address, loc)) {
-        missCountdown = missPenalty-1;
-        if (name == "L1"){
-            entry.L1_penality = missCountdown;
-        }else{
-            entry.L2_penality = missCountdown;
-        }
-        return false;
+        DEBUG(cout << name + " Cache (miss): line " << std::hex << address << std::dec << "\n");
+        misses++;
+        return -1;
     }
-    read_data = line[loc].data[getOffset(address)/4]; 
-    DEBUG(cout << name + " Cache (read hit): " << read_data << "<-[" << std::hex << address << std::dec << "]\n");
-    entry.success = true;
-    entry.write_value = read_data;
-    return true;
+    DEBUG(cout << name + " Cache (hit): line " << std::hex << address << std::dec << "\n");
+    hits++;
+    return loc;
 }
 
-// Write a word to this cache
-bool Cache::write(uint32_t address, uint32_t write_data, MSHREntry &entry) {
-    uint32_t loc = 0;
-    int missCountdown = name == "L1"? entry.L1_penality : entry.L2_penality;
-    if (missCountdown) {
-        DEBUG(cout << name + " Cache (write miss) at address " << std::hex << address << std::dec << ": " << missCountdown << " cycles remaining to be serviced\n");
-        missCountdown--;
-        if (name == "L1"){
-            entry.L1_penality = missCountdown;
-        }else{
-            entry.L2_penality = missCountdown;
-        }
-        return false;
+// Gathers one way back into a line
+CacheLine Cache::lineAt(int slot) const {
+    CacheLine c;
+    const uint32_t *words = lineData(slot);
+    for (int i = 0; i < CACHE_LINE_SIZE/4; i++) {
+        c.data[i] = words[i];
     }
-    // Once miss penalty is completely paid, isHit should return true
-    if (!isHit(address, loc)) {
-        missCountdown = missPenalty-1;
-        if (name == "L1"){
-            entry.L1_penality = missCountdown;
-        }else{
-            entry.L2_penality = missCountdown;
-        }
-        return false;
+    c.valid = tags[slot] != INVALID_TAG;
+    if (c.valid) {
+        c.address = lineAddress(slot);
+        c.tag = tags[slot];
     }
-    line[loc].data[getOffset(address)/4] = write_data;
-    line[loc].dirty = true; 
-    DEBUG(cout << name + " Cache (write hit): [" << std::hex << address << std::dec << "]<-" << write_data << "\n");
-    entry.success = true;
-    return true;
+    c.dirty = dirty[slot];
+    return c;
 }
 
 // Call this only if you know that a valid line with matching tag exists at that address 
 CacheLine Cache::readLine(uint32_t address) {
-    int idx = getIndex(address);
-    int tag = getTag(address);
-
-    for (int w=0; w<assoc; w++) {
-        if (line[idx*assoc+w].valid && line[idx*assoc+w].tag == tag) {
-            return line[idx*assoc+w];
-        }
+    int slot = findSlot(address);
+    if (slot >= 0) {
+        return lineAt(slot);
     }
     CacheLine c;
     c.valid = false;
@@ -124,114 +71,335 @@ CacheLine Cache::readLine(uint32_t address) {
 }
 
 // Call this only if you know that a valid line with matching tag exists at that address 
-void Cache::writeBackLine(CacheLine evictedLine) {
-    int idx = getIndex(evictedLine.address);
-    int tag = getTag(evictedLine.address);
-
-    for (int w=0; w<assoc; w++) {
-        if (line[idx*assoc+w].valid && line[idx*assoc+w].tag == tag) {
-            for (int i = 0; i < CACHE_LINE_SIZE/4; i++) {
-                line[idx*assoc+w].data[i] = evictedLine.data[i];
-            }
-            line[idx*assoc+w].dirty = true;
+void Cache::writeBackLine(const CacheLine &evictedLine) {
+    int slot = findSlot(evictedLine.address);
+    if (slot >= 0) {
+        uint32_t *words = lineData(slot);
+        for (int i = 0; i < CACHE_LINE_SIZE/4; i++) {
+            words[i] = evictedLine.data[i];
         }
+        dirty[slot] = true;
     }
 }
 
 // Replace a line at the set corresponding this address
-void Cache::replace(uint32_t address, CacheLine newLine, CacheLine &evictedLine) {
+void Cache::replace(uint32_t address, const CacheLine &newLine, CacheLine &evictedLine) {
     
     int idx = getIndex(address);
-    newLine.address = address;
-    newLine.tag = getTag(address);
-    newLine.valid = true;
-    newLine.replBits = assoc - 1;
+    uint32_t tag = getTag(address);
 
     /* Return if replacement already completed. */ 
-    for (int w=0; w<assoc; w++) {
-        if (line[idx*assoc+w].valid && line[idx*assoc+w].tag == newLine.tag) {
-            updateReplacementBits(idx, w);
-            return;
-        }
+    int way = findWay(idx, tag);
+    if (way >= 0) {
+        policy->refill(idx, way, &tags[idx*assoc]);
+        return;
     }
     /* Replace. */ 
-    for (int w=0; w<assoc; w++) {
-        if (!line[idx*assoc+w].valid || line[idx*assoc+w].replBits == 0) {
-            DEBUG(cout << name + " Cache: replacing line at idx:" << idx << " way:" << w << " due to conflicting address:" << std::hex << address << std::dec << "\n");
-            evictedLine = line[idx*assoc+w];
-            line[idx*assoc+w] = newLine;
-            return;
-        }else{
-            line[idx*assoc+w].replBits -= 1;
+    way = policy->victim(idx, &tags[idx*assoc]);
+    if (way < 0) {
+        return;
+    }
+    int slot = idx*assoc+way;
+    DEBUG(cout << name + " Cache: replacing line at idx:" << idx << " way:" << way << " due to conflicting address:" << std::hex << address << std::dec << "\n");
+    evictedLine = lineAt(slot);
+    tags[slot] = tag;
+    dirty[slot] = newLine.dirty;
+    uint32_t *words = lineData(slot);
+    for (int i = 0; i < CACHE_LINE_SIZE/4; i++) {
+        words[i] = newLine.data[i];
+    }
+    policy->insert(idx, way, &tags[idx*assoc]);
+}
+
+// Overwrites a word of a cached line without touching dirty or replacement state
+void Cache::patchWord(uint32_t address, uint32_t value) {
+    int slot = findSlot(address);
+    if (slot >= 0) {
+        lineData(slot)[getOffset(address)/4] = value;
+    }
+}
+
+// Returns copies of all dirty lines and marks them clean
+std::vector<CacheLine> Cache::takeDirtyLines() {
+    std::vector<CacheLine> lines;
+    for (size_t slot = 0; slot < tags.size(); slot++) {
+        if (tags[slot] != INVALID_TAG && dirty[slot]) {
+            lines.push_back(lineAt(slot));
+            dirty[slot] = false;
+        }
+    }
+    return lines;
+}
+
+void Cache::invalidateAll() {
+    std::fill(tags.begin(), tags.end(), INVALID_TAG);
+    std::fill(dirty.begin(), dirty.end(), 0);
+    policy->clear();
+}
+
+void Cache::save(CheckpointWriter &out) const {
+    out.section("CACH");
+    out.put(size);
+    out.put(assoc);
+    std::vector<CacheLine> lines(tags.size());
+    for (size_t slot = 0; slot < tags.size(); slot++) {
+        lines[slot] = lineAt(slot);
+    }
+    out.putVector(lines);
+    std::string repl = policy->name();
+    out.putVector(std::vector<char>(repl.begin(), repl.end()));
+    policy->save(out);
+}
+
+void Cache::restore(CheckpointReader &in) {
+    in.section("CACH");
+    int saved_size = in.get<int>();
+    int saved_assoc = in.get<int>();
+    if (saved_size != size || saved_assoc != assoc) {
+        in.fail();
+        return;
+    }
+    std::vector<CacheLine> lines(tags.size());
+    in.getVector(lines);
+    std::string repl = policy->name();
+    std::vector<char> saved_repl(repl.size());
+    in.getVector(saved_repl);
+    if (!in.good() || std::string(saved_repl.begin(), saved_repl.end()) != repl) {
+        in.fail();
+        return;
+    }
+    policy->restore(in);
+    for (size_t slot = 0; slot < lines.size(); slot++) {
+        tags[slot] = lines[slot].valid ? getTag(lines[slot].address) : INVALID_TAG;
+        dirty[slot] = lines[slot].dirty;
+        uint32_t *words = lineData(slot);
+        for (int i = 0; i < CACHE_LINE_SIZE/4; i++) {
+            words[i] = lines[slot].data[i];
         }
     }
 }
 
 // Invalidate a line
 void Cache::invalidateLine(uint32_t address) {
-    int idx = getIndex(address);
-    int tag = getTag(address);
+    int slot = findSlot(address);
+    if (slot >= 0) {
+        tags[slot] = INVALID_TAG;
+    }
+}
 
-    for (int w=0; w<assoc; w++) {
-        if (line[idx*assoc+w].valid && line[idx*assoc+w].tag == tag) {
-            line[idx*assoc+w].valid = false;
+// Brings the line holding address into L2 from memory. The hierarchy is
+// inclusive, so a line evicted from L2 leaves L1 as well.
+void Memory::fillL2(uint32_t address) {
+    uint32_t lineAddr = address & ~(CACHE_LINE_SIZE-1);
+    CacheLine c;
+    CacheLine evictedLine;
+    evictedLine.valid = false;
+    DEBUG(print(lineAddr, 8));
+    for (int i = 0; i < CACHE_LINE_SIZE/4; i++) {
+       c.data[i] = mem.load(lineAddr + 4*i);
+    }
+    L2.replace(address, c, evictedLine); 
+
+    // model an inclusive hierarchy; a dirty L1 copy is newer than L2's
+    if (evictedLine.valid) {
+        CacheLine upper = L1.readLine(evictedLine.address);
+        if (upper.valid && upper.dirty) {
+            evictedLine = upper;
+        }
+        L1.invalidateLine(evictedLine.address);
+    }
+
+    // writeback dirty line
+    if (evictedLine.valid && evictedLine.dirty) {
+        lineAddr = evictedLine.address & ~(CACHE_LINE_SIZE-1);
+        for (int i = 0; i < CACHE_LINE_SIZE/4; i++) {
+           mem.store(lineAddr + 4*i, evictedLine.data[i]);
         }
     }
 }
 
+// Brings the line holding address into L1 from L2
+void Memory::fillL1(uint32_t address) {
+    CacheLine evictedLine;
+    L1.replace(address, L2.readLine(address), evictedLine);
+
+    // writeback dirty line
+    if (evictedLine.valid && evictedLine.dirty) {
+        L2.writeBackLine(evictedLine);
+    }
+}
+
+void Memory::schedule(int slot, int delay) {
+    mshr[slot].due = now + delay;
+    wheel[mshr[slot].due & (wheel.size() - 1)].push_back(slot);
+}
+
 void Memory::tick(){
+    completed.clear();
+    now++;
+    // Requests due now only reschedule themselves for later ticks, so the
+    // bucket does not change while it is walked
+    std::vector<int> &bucket = wheel[now & (wheel.size() - 1)];
+    for (int slot : bucket) {
+        advance(slot);
+    }
+    bucket.clear();
+}
 
-    for (auto &entry : mshr.entries) { 
-        if ((!entry.is_write && L1.read(entry.address, entry.write_value, entry)) || (entry.is_write && L1.write(entry.address, entry.write_value, entry))) {
-        } else if ((!entry.is_write && L2.read(entry.address, entry.write_value, entry)) || (entry.is_write && L2.write(entry.address, entry.write_value, entry))) {
-            // Read from L2 but don't return a success status until miss penalty is paid off completely
-            CacheLine evictedLine;
-            L1.replace(entry.address, L2.readLine(entry.address), evictedLine);
-    
-            // writeback dirty line
-            if (evictedLine.valid && evictedLine.dirty) {
-                L2.writeBackLine(evictedLine);
-            }
+// Runs the request's current stage. A hit in L1 completes it; otherwise it
+// waits out the L1 penalty for a line in L2, or the memory latency, and is
+// then filled and completed in one go
+void Memory::advance(int slot) {
+    MSHREntry &entry = mshr[slot];
+    int loc;
+    switch (entry.stage) {
+    case MSHR_LOOKUP:
+        loc = L1.probe(entry.address);
+        if (loc >= 0) {
+            serve(slot, loc);
+        } else if (L2.probe(entry.address) >= 0) {
+            entry.stage = MSHR_FILL_L1;
+            schedule(slot, L1.penalty());
         } else {
-            // Read from memory but don't return a success status until miss penalty is paid off completely
-            int lineAddr = entry.address & ~(CACHE_LINE_SIZE-1);
-            CacheLine c;
-            CacheLine evictedLine;
-            evictedLine.valid = false;
-            DEBUG(print(lineAddr, 8));
-            for (int i = 0; i < CACHE_LINE_SIZE/4; i++) {
-               c.data[i] = mem[lineAddr/4+i];
-            }
-            L2.replace(entry.address, c, evictedLine); 
-    
-            // model an inclusive hierarchy
-            if (evictedLine.valid) {
-                L1.invalidateLine(evictedLine.address);
-            }
-    
-            // writeback dirty line
-            if (evictedLine.valid && evictedLine.dirty) {
-                lineAddr = evictedLine.address & ~(CACHE_LINE_SIZE-1);
-                for (int i = 0; i < CACHE_LINE_SIZE/4; i++) {
-                   mem[lineAddr/4+i] = evictedLine.data[i];
-                }
-            }
+            entry.stage = MSHR_FILL_L2;
+            schedule(slot, memory_latency);
         }
-        
+        return;
+    case MSHR_FILL_L2:
+        fillL2(entry.address);
+        break;
+    case MSHR_FILL_L1:
+        if (!L2.holds(entry.address)) {
+            // Another fill took the line out of L2 meanwhile; fetch it again
+            entry.stage = MSHR_FILL_L2;
+            schedule(slot, memory_latency);
+            return;
+        }
+        break;
+    }
+    if (L2.holds(entry.address)) {
+        fillL1(entry.address);
     }
+    loc = L1.locate(entry.address);
+    if (loc < 0) {
+        // The LRU policy may only age the set on a fill; retry next tick
+        schedule(slot, 1);
+        return;
+    }
+    serve(slot, loc);
+}
 
+// The line is in L1: serve every merged request in arrival order
+void Memory::serve(int slot, int loc) {
+    MSHREntry &entry = mshr[slot];
+    for (int t = 0; t < entry.num_targets; t++) {
+        MSHRTarget &target = entry.targets[t];
+        if (target.is_write) {
+            L1.writeWord(loc, target.address, target.value);
+        } else {
+            target.value = L1.readWord(loc, target.address);
+        }
+        completed.push_back(target);
+    }
+    mshr.release(slot);
 }
 
+// Leaves L1 and L2 holding the line as if a timed access to it had completed.
+// Like tick(), this retries: replace() may only age the set on a given call.
+void Memory::warm(uint32_t address) {
+    uint32_t loc;
+    while (!L1.isHit(address, loc)) {
+        while (!L2.isHit(address, loc)) {
+            fillL2(address);
+        }
+        fillL1(address);
+    }
+}
 
+// Writes every dirty line back (L1 into L2, L2 into memory) and marks it clean
+void Memory::clean() {
+    for (const CacheLine &dirty : L1.takeDirtyLines()) {
+        L2.writeBackLine(dirty);
+    }
+    for (const CacheLine &dirty : L2.takeDirtyLines()) {
+        uint32_t lineAddr = dirty.address & ~(CACHE_LINE_SIZE-1);
+        for (int i = 0; i < CACHE_LINE_SIZE/4; i++) {
+           mem.store(lineAddr + 4*i, dirty.data[i]);
+        }
+    }
+}
 
+uint64_t Memory::quietCycles() const {
+    if (mshr.empty()) {
+        return 0;
+    }
+    uint64_t next = UINT64_MAX;
+    for (int slot : mshr.slots()) {
+        next = std::min(next, mshr[slot].due);
+    }
+    return next - now - 1;
+}
+
+void Memory::printStats(std::ostream &out) const {
+    for (const Cache *cache : {&L1, &L2}) {
+        uint64_t lookups = cache->lookups();
+        out << (cache == &L1 ? "L1" : "L2") << " (" << cache->policyName() << "): " << lookups << " lookups, " <<
+               cache->lookupMisses() << " misses";
+        if (lookups) {
+            out << " (" << std::fixed << std::setprecision(2) << 100.0 * cache->lookupMisses() / lookups << "%)";
+            out << std::defaultfloat;
+        }
+        out << "\n";
+    }
+}
+
+void Memory::emptyCaches() {
+    clean();
+    L1.invalidateAll();
+    L2.invalidateAll();
+}
+
+void Memory::save(CheckpointWriter &out) const {
+    out.section("MEM ");
+    mem.save(out);
+    out.put(predecode.regionBase());
+    out.put(predecode.regionSize());
+    L1.save(out);
+    L2.save(out);
+}
+
+void Memory::restore(CheckpointReader &in) {
+    in.section("MEM ");
+    mem.restore(in);
+    uint32_t text_base = in.get<uint32_t>();
+    uint32_t text_size = in.get<uint32_t>();
+    L1.restore(in);
+    L2.restore(in);
+    flushRequests();
+    if (in.good()) {
+        predecode.setRegion(text_base, text_size);
+        for (uint32_t pc = text_base; pc < text_base + text_size; pc += 4) {
+            predecode.fill(pc, mem.load(pc));
+        }
+    }
+}
 
 bool Memory::access(uint32_t address, uint32_t &read_data, uint32_t write_data, bool mem_read, bool mem_write) {
     if (opt_level == 0) {
+        if (warming && (mem_read || mem_write)) {
+            warm(address);
+        }
         if (mem_read) {
-            read_data = mem[address/4];
+            read_data = mem.load(address);
         }
         if (mem_write) {
-            mem[address/4] = write_data;
+            mem.store(address, write_data);
+            predecode.invalidate(address & ~3u);
+            if (warming) {
+                // Caches stay clean while warming; keep their copies current
+                L1.patchWord(address, write_data);
+                L2.patchWord(address, write_data);
+            }
         }
         return true;
     }
@@ -240,34 +408,45 @@ bool Memory::access(uint32_t address, uint32_t &read_data, uint32_t write_data,
         return true;
     }
 
-    if (mem_write) {
-        MSHREntry entry;
-        entry.address = address;
-        entry.write_value = write_data;
-        entry.is_write = true;
-        entry.L1_penality = 0;
-        entry.L2_penality = 0;
-        entry.success = false;
-        mshr.entries.push_back(entry);
-        return false;
-    }
-
-    for (auto &entry : mshr.entries) {
-        if (entry.is_write && entry.address == address) {
-            read_data = entry.write_value;
-            return true;
+    MSHREntry *entry = mshr.find(address);
+    if (mem_read && entry) {
+        // Forward the newest store to this word, or wait with the older load
+        for (int t = entry->num_targets - 1; t >= 0; t--) {
+            const MSHRTarget &target = entry->targets[t];
+            if (target.address == address) {
+                read_data = target.value;
+                return target.is_write;
+            }
         }
-        if (!entry.is_write && entry.address == address) {
-            return false;
+    }
+    if (!entry) {
+        int slot = mshr.allocate(address);
+        if (slot >= 0) {
+            entry = &mshr[slot];
+            schedule(slot, 1);
         }
     }
+    // Callers check canAccept first
+    if (entry && entry->num_targets < MSHR_TARGETS) {
+        entry->targets[entry->num_targets++] = {address, mem_write, write_data};
+    }
+    if (mem_write) {
+        predecode.invalidate(address & ~3u);
+    }
+    return false;
+}
 
-    MSHREntry entry;
-    entry.address = address;
-    entry.is_write = false;
-    entry.L1_penality = 0;
-    entry.L2_penality = 0;
-    entry.success = false;
-    mshr.entries.push_back(entry);
+bool Memory::canAccept(uint32_t address, bool mem_write) {
+    const MSHREntry *entry = mshr.find(address);
+    if (!entry) {
+        return !mshr.full();
+    }
+    if (entry->num_targets < MSHR_TARGETS) {
+        return true;
+    }
+    // A load of a word already requested needs no target of its own
+    for (int t = 0; !mem_write && t < entry->num_targets; t++) {
+        if (entry->targets[t].address == address) return true;
+    }
     return false;
 }
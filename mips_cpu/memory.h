@@ -5,134 +5,317 @@
 #include <iostream>
 #include <cmath>
 #include <deque>
+#include <algorithm>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "decode.h"
+#include "checkpoint.h"
+#include "replacement.h"
+#include "paged_memory.h"
 
 
 #define CACHE_LINE_SIZE 64
-
-struct MSHREntry {
+#define CACHE_ASSOC 8
+#define DEFAULT_L1_SIZE 32768
+#define DEFAULT_L2_SIZE 262144
+#define DEFAULT_MSHRS 16
+#define MAX_MSHRS 1024
+#define MSHR_TARGETS 8
+
+// One word-sized request waiting on a line
+struct MSHRTarget {
     uint32_t address;
     bool is_write;
-    uint32_t write_value;
-    int L1_penality;
-    int L2_penality;
-    bool success;
+    uint32_t value;         // data to store, or the word loaded once complete
+};
+
+// What an MSHR entry does once it is due: look its line up, or bring the
+// line into L1 (from L2) or into both levels (from memory) and complete
+enum { MSHR_LOOKUP, MSHR_FILL_L1, MSHR_FILL_L2 };
+
+// An outstanding access to one cache line. Requests to other words of the
+// line made while it is outstanding merge onto it as further targets and
+// complete with it
+struct MSHREntry {
+    uint32_t address;       // line address
+    uint8_t stage;
+    uint64_t due;           // tick at which the stage runs
+    int num_targets;
+    MSHRTarget targets[MSHR_TARGETS];
 };
 
+// A fixed number of MSHRs, found by line address through a small
+// open-addressing table
 class MSHR {
+    private:
+        std::vector<MSHREntry> entries;
+        std::vector<int> free_slots;
+        std::vector<int> active;            // busy slots, oldest first
+        std::vector<int16_t> table;         // line address -> slot, -1 if empty
+        uint32_t mask;
 
-public:
-    std::deque<MSHREntry> entries;
-    const std::deque<MSHREntry>& getEntries() const {
-        return entries;
-    }
+        uint32_t home(uint32_t line) const { return ((line / CACHE_LINE_SIZE) * 2654435761u) & mask; }
+
+    public:
+        MSHR(int capacity = DEFAULT_MSHRS) : entries(capacity) {
+            uint32_t size = 4;
+            while (size < 2 * (uint32_t)capacity) size *= 2;
+            table.assign(size, -1);
+            mask = size - 1;
+            flush();
+        }
+
+        int capacity() const { return entries.size(); }
+        bool empty() const { return active.empty(); }
+        bool full() const { return free_slots.empty(); }
+
+        // Busy slots in allocation order, and the entry in a slot
+        const std::vector<int> &slots() const { return active; }
+        MSHREntry &operator[](int slot) { return entries[slot]; }
+        const MSHREntry &operator[](int slot) const { return entries[slot]; }
+
+        // Entry for the line holding address, or null
+        MSHREntry *find(uint32_t address) {
+            uint32_t line = address & ~(CACHE_LINE_SIZE-1);
+            for (uint32_t i = home(line); table[i] >= 0; i = (i + 1) & mask) {
+                if (entries[table[i]].address == line) return &entries[table[i]];
+            }
+            return nullptr;
+        }
 
-    void insert(uint32_t address, bool is_write, uint32_t value, int L1_penality, int L2_penality) {
-        entries.push_back({address, is_write, value, L1_penality, L2_penality, false});
-    }
+        // Slot of a new entry for the line holding address, about to be
+        // looked up; -1 if all are busy
+        int allocate(uint32_t address) {
+            if (free_slots.empty()) {
+                return -1;
+            }
+            int slot = free_slots.back();
+            free_slots.pop_back();
+            active.push_back(slot);
+            MSHREntry &entry = entries[slot];
+            entry.address = address & ~(CACHE_LINE_SIZE-1);
+            entry.stage = MSHR_LOOKUP;
+            entry.num_targets = 0;
+            uint32_t i = home(entry.address);
+            while (table[i] >= 0) i = (i + 1) & mask;
+            table[i] = slot;
+            return slot;
+        }
 
-    bool contains(uint32_t address) const {
-        for (const auto& entry : entries) {
-            if (entry.address == address) return true;
+        // Frees a slot, keeping the others in order
+        void release(int slot) {
+            active.erase(std::find(active.begin(), active.end(), slot));
+            free_slots.push_back(slot);
+            // Remove from the table, shifting back later entries of the same run
+            uint32_t i = home(entries[slot].address);
+            while (table[i] != slot) i = (i + 1) & mask;
+            table[i] = -1;
+            for (uint32_t j = (i + 1) & mask; table[j] >= 0; j = (j + 1) & mask) {
+                uint32_t k = home(entries[table[j]].address);
+                if (((j - k) & mask) >= ((j - i) & mask)) {
+                    table[i] = table[j];
+                    table[j] = -1;
+                    i = j;
+                }
+            }
         }
-        return false;
-    }
 
+        void print() const {
+            static const char *stages[] = {"lookup", "fill L1", "fill L2"};
+            for (int slot : active) {
+                const MSHREntry &entry = entries[slot];
+                std::cout << "Line: " << std::hex << entry.address << std::dec
+                          << ", Next: " << stages[entry.stage] << " at " << entry.due
+                          << ", Targets: " << entry.num_targets << "\n";
+            }
+        }
 
-    void flush() {
-        entries.clear();
-    }
+        void flush() {
+            active.clear();
+            free_slots.clear();
+            for (int slot = capacity() - 1; slot >= 0; slot--) {
+                free_slots.push_back(slot);
+            }
+            std::fill(table.begin(), table.end(), -1);
+        }
 };
 
 
 
 
+// A line as it moves between the caches and memory; the caches themselves
+// keep tags and data in separate arrays
 struct CacheLine {
     uint32_t data[CACHE_LINE_SIZE/4] = {0};
     uint32_t address = 0;
     int tag = 0;
     bool valid = false;
     bool dirty = false;
-    uint8_t replBits = 0;
 };
 
 class Cache {
     private:
-        std::vector<CacheLine> line;
+        // Tag store, one entry per way (set-major), kept apart from the data
+        // so a lookup only touches assoc consecutive tags
+        std::vector<uint32_t> tags;
+        std::vector<uint8_t> dirty;
+        std::unique_ptr<ReplacementPolicy> policy;
+        // Data store, CACHE_LINE_SIZE/4 words per way
+        std::vector<uint32_t> data;
         int size;
         int assoc;
         int missPenalty;
         int missCountdown;
+        // Address geometry, fixed at construction
+        int offset_bits;
+        uint32_t index_mask;
+        int tag_shift;
         std::string name;
+        // Lookups of arriving requests, hit or miss
+        uint64_t hits;
+        uint64_t misses;
+
+        static int log2i(int value) {
+            int bits = 0;
+            while ((1 << (bits + 1)) <= value) bits++;
+            return bits;
+        }
+        uint32_t *lineData(int slot) { return &data[slot * (CACHE_LINE_SIZE/4)]; }
+        const uint32_t *lineData(int slot) const { return &data[slot * (CACHE_LINE_SIZE/4)]; }
+        uint32_t lineAddress(int slot) const {
+            return (tags[slot] << tag_shift) | ((uint32_t)(slot / assoc) << offset_bits);
+        }
+        CacheLine lineAt(int slot) const;
+
+        // Way of the set holding tag, or -1
+        int findWay(int idx, uint32_t tag) const {
+            const uint32_t *ways = &tags[idx*assoc];
+#if defined(__AVX2__)
+            if (assoc == 8) {
+                __m256i match = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)ways), _mm256_set1_epi32(tag));
+                int bits = _mm256_movemask_ps(_mm256_castsi256_ps(match));
+                return bits ? __builtin_ctz(bits) : -1;
+            }
+#endif
+#if defined(__SSE2__)
+            if (assoc % 4 == 0) {
+                __m128i key = _mm_set1_epi32(tag);
+                for (int w = 0; w < assoc; w += 4) {
+                    __m128i match = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(ways + w)), key);
+                    int bits = _mm_movemask_ps(_mm_castsi128_ps(match));
+                    if (bits) return w + __builtin_ctz(bits);
+                }
+                return -1;
+            }
+#endif
+            for (int w = 0; w < assoc; w++) {
+                if (ways[w] == tag) return w;
+            }
+            return -1;
+        }
+        int findSlot(uint32_t address) const {
+            int idx = getIndex(address);
+            int w = findWay(idx, getTag(address));
+            return w < 0 ? -1 : idx*assoc + w;
+        }
     public:
-        Cache(std::string nm, int sz, int asc, int penalty) {
+        // sz must give a power-of-two number of sets, and repl name a policy
+        // makeReplacementPolicy accepts
+        Cache(std::string nm, int sz, int asc, int penalty, const std::string &repl = "lru") {
             name = nm;
             size = sz;
             assoc = asc;
-            line.resize(size/CACHE_LINE_SIZE);
+            int lines = size/CACHE_LINE_SIZE;
+            tags.assign(lines, INVALID_TAG);
+            dirty.assign(lines, 0);
+            policy = makeReplacementPolicy(repl, lines/assoc, assoc);
+            hits = 0;
+            misses = 0;
+            data.assign(lines * (CACHE_LINE_SIZE/4), 0);
+
+            offset_bits = log2i(CACHE_LINE_SIZE);
+            index_mask = lines/assoc - 1;
+            tag_shift = offset_bits + log2i(lines/assoc);
 
-            for (int i = 0; i < (size/CACHE_LINE_SIZE); i++) {
-                line[i].valid = false;
-                line[i].replBits = 0;
-            }
-            
             missCountdown = 0;
             missPenalty = penalty;
         }
 
         // offset, index, tag computation
-        int getOffset(uint32_t address) {
+        int getOffset(uint32_t address) const {
             return address & (CACHE_LINE_SIZE-1);
         }
-        int getIndex(uint32_t address) {
-            return (address >> (int)log2(CACHE_LINE_SIZE)) & (size/CACHE_LINE_SIZE/assoc-1);
+        int getIndex(uint32_t address) const {
+            return (address >> offset_bits) & index_mask;
         }
-        int getTag(uint32_t address) {
-            int index_bits = log2(size/CACHE_LINE_SIZE/assoc);
-            int offset_bits = log2(CACHE_LINE_SIZE);
-            return address >> (index_bits+offset_bits);
+        uint32_t getTag(uint32_t address) const {
+            return address >> tag_shift;
         }
 
         // Check if hit in the cache
         bool isHit(uint32_t address, uint32_t &loc);
 
-        // Update replacement bits after access
-        void updateReplacementBits(int idx, int way);
 
-        // Read a word from this cache
-        bool read(uint32_t address, uint32_t &read_data, MSHREntry &entry);
+        // Looks an arriving request's line up and counts the hit or miss:
+        // the slot holding the line, or -1
+        int probe(uint32_t address);
 
-        // Write a word to this cache
-        bool write(uint32_t address, uint32_t write_data, MSHREntry &entry);
+        // Slot holding the line, or -1; no replacement or stats update
+        int locate(uint32_t address) const { return findSlot(address); }
+
+        // A word of the line in slot loc; writes leave the line dirty
+        uint32_t readWord(int loc, uint32_t address) const { return lineData(loc)[getOffset(address)/4]; }
+        void writeWord(int loc, uint32_t address, uint32_t value) {
+            lineData(loc)[getOffset(address)/4] = value;
+            dirty[loc] = true;
+        }
 
         // Call this only if you know that a valid line with matching tag exists at that address 
         CacheLine readLine(uint32_t address);
 
         // Call this only if you know that a valid line with matching tag exists at that address 
-        void writeBackLine(CacheLine evictedLine);
+        void writeBackLine(const CacheLine &evictedLine);
 
         // Replace a line at the set corresponding this address
-        void replace(uint32_t address, CacheLine newLine, CacheLine &evictedLine);
+        void replace(uint32_t address, const CacheLine &newLine, CacheLine &evictedLine);
 
         // Invalidate a line
         void invalidateLine(uint32_t address);
 
+        bool holds(uint32_t address) const { return findSlot(address) >= 0; }
+        int penalty() const { return missPenalty; }
+
+        const char *policyName() const { return policy->name(); }
+        uint64_t lookups() const { return hits + misses; }
+        uint64_t lookupMisses() const { return misses; }
+
+        // Invalidate every line; dirty data is lost
+        void invalidateAll();
+
+        // Overwrite one word of a cached line, leaving it clean (functional warming)
+        void patchWord(uint32_t address, uint32_t value);
+
+        // Copies of the dirty lines; they are marked clean
+        std::vector<CacheLine> takeDirtyLines();
+
+        // Lines with their data, dirty and replacement state. Restoring needs
+        // the same geometry and replacement policy the checkpoint was taken with
+        void save(CheckpointWriter &out) const;
+        void restore(CheckpointReader &in);
+
         // Print a cache line
         void printLine(uint32_t address) {
-            int idx = getIndex(address);
-            int tag = getTag(address);
-
-            for (int w=0; w<assoc; w++) {
-                if (line[idx*assoc+w].valid && line[idx*assoc+w].tag == tag) {
-                    std::cout<< "Valid:" << line[idx*assoc+w].valid << "\n";
-                    std::cout<< "Address:" << line[idx*assoc+w].address << "\n";
-                    std::cout<< "Tag:" << line[idx*assoc+w].tag << "\n";
-                    std::cout<< "Dirty:" << line[idx*assoc+w].dirty << "\n";
-                    std::cout<< "Replacement Bits:" << line[idx*assoc+w].replBits << "\n";
-                    for (int i = 0; i < CACHE_LINE_SIZE/4; i++) {
-                        std::cout<< "DATA[" << i << "]: " << line[idx*assoc+w].data[i] << "\n";
-                    }
-                    return;
-                }
+            int slot = findSlot(address);
+            if (slot < 0) {
+                return;
+            }
+            std::cout<< "Valid:" << 1 << "\n";
+            std::cout<< "Address:" << lineAddress(slot) << "\n";
+            std::cout<< "Tag:" << tags[slot] << "\n";
+            std::cout<< "Dirty:" << (int)dirty[slot] << "\n";
+            for (int i = 0; i < CACHE_LINE_SIZE/4; i++) {
+                std::cout<< "DATA[" << i << "]: " << lineData(slot)[i] << "\n";
             }
         }
 };
@@ -140,36 +323,144 @@ class Cache {
 
 class Memory {
     private:
-        std::vector<uint32_t> mem;
-        Cache L1 = Cache("L1", 32768, 8, 12);
-        Cache L2 = Cache("L2", 262144, 8, 59);
+        PagedMemory mem;
+        Cache L1;
+        Cache L2;
         int opt_level;
+        bool warming;
+
+        void fillL1(uint32_t address);
+        void fillL2(uint32_t address);
+        void warm(uint32_t address);
+        std::vector<MSHRTarget> completed;
+
+        // Timing wheel of outstanding requests: bucket c % size holds the
+        // MSHR slots due at tick c. Every delay is shorter than the wheel,
+        // so a bucket only ever holds one tick's requests
+        std::vector<std::vector<int>> wheel;
+        uint64_t now;               // ticks so far
+        // A line from memory: the L2 penalty, then ready at the L1 retry
+        // after it (requests used to re-check L1 every L1 penalty)
+        int memory_latency;
+
+        void schedule(int slot, int delay);
+        void advance(int slot);
+        void serve(int slot, int loc);
     public:
         MSHR mshr;
+        DecodeCache predecode;      // decoded text, kept coherent with stores
         
-        Memory() {
-            mem.resize(2097152, 0);
+        // Cache sizes are in bytes; see validCacheSizes. l1_repl/l2_repl name
+        // each level's replacement policy; see validReplacementPolicy
+        Memory(int l1_size = DEFAULT_L1_SIZE, int l2_size = DEFAULT_L2_SIZE,
+               const std::string &l1_repl = "lru", const std::string &l2_repl = "lru", int mshrs = DEFAULT_MSHRS)
+            : L1("L1", l1_size, CACHE_ASSOC, 12, l1_repl), L2("L2", l2_size, CACHE_ASSOC, 59, l2_repl), mshr(mshrs) {
             opt_level = 0;
+            warming = false;
+            now = 0;
+            memory_latency = (L2.penalty() / L1.penalty() + 1) * L1.penalty();
+            size_t buckets = 1;
+            while (buckets <= (size_t)memory_latency) buckets *= 2;
+            wheel.resize(buckets);
+        }
+        // Both caches need a power-of-two number of sets, and the inclusive
+        // hierarchy needs L2 at least as large as L1
+        static bool validCacheSizes(int l1_size, int l2_size) {
+            for (int size : {l1_size, l2_size}) {
+                int sets = size / (CACHE_LINE_SIZE * CACHE_ASSOC);
+                if (sets < 1 || size % (CACHE_LINE_SIZE * CACHE_ASSOC) || (sets & (sets - 1))) {
+                    return false;
+                }
+            }
+            return l2_size >= l1_size;
+        }
+        // lru (the default), plru, srrip, brrip, dip or random[:<seed>]
+        static bool validReplacementPolicy(const std::string &name) {
+            return makeReplacementPolicy(name, 1, CACHE_ASSOC) != nullptr;
         }
         void setOptLevel(int level) {
             opt_level = level;
         }
+        // With opt level 0, also bring every accessed line into L1/L2 (with
+        // no timing), so a later detailed run starts with warm caches
+        void setWarming(bool on) {
+            warming = on;
+        }
+        // Writes dirty cache lines back to memory; needed before anything
+        // reads the backing store directly after a timed run
+        void clean();
+
+        // Ticks before the next outstanding request is due, during which
+        // tick() does nothing; 0 with none outstanding
+        uint64_t quietCycles() const;
+
+        // Passes over that many ticks; cycles must not exceed quietCycles()
+        void skipCycles(uint64_t cycles) { now += cycles; }
+
+        // Per-level lookups and misses: each request looks L1 up once when it
+        // arrives, and L2 once if it missed in L1
+        void printStats(std::ostream &out) const;
+        // Fraction of first lookups that missed in L1 (level 0) or L2 (level 1)
+        double missRate(int level) const {
+            const Cache &cache = level ? L2 : L1;
+            return cache.lookups() ? (double)cache.lookupMisses() / cache.lookups() : 0;
+        }
+
+        // A pipeline flush: no request in flight completes any more, but the
+        // lines already on their way are still filled, as the hardware would
+        void squashRequests() {
+            for (int slot : mshr.slots()) {
+                mshr[slot].num_targets = 0;
+            }
+        }
+
+        // Drops every request in flight, fills and all (switching engines)
+        void flushRequests() {
+            mshr.flush();
+            for (std::vector<int> &bucket : wheel) {
+                bucket.clear();
+            }
+        }
+
+        // Writes back and invalidates both caches. The functional engine
+        // bypasses them, so it must not leave stale copies behind
+        void emptyCaches();
+
+        // Memory contents and both caches. Requests in flight are not saved,
+        // so the MSHR must be empty. restore() re-decodes the text region
+        void save(CheckpointWriter &out) const;
+        void restore(CheckpointReader &in);
         // address is the adress which needs to be read or written from
         // read_data the variable into which data is read, it is passed by reference
         // write_data is the data which is written into the memory address provided
         // mem_read specifies whether memory should be read or not
         // mem_write specifies whether memory whould be written to or not
         // returns false if there is a cache miss (O1 and above) 
-        // -- currently follows stall-on-miss model, so call every cycle until you see a hit
+        // -- above O0 every access goes through the MSHRs: false means the
+        // request is outstanding and completes in a later tick(). A load of
+        // a word with a store outstanding gets the stored value right away
         bool access(uint32_t address, uint32_t &read_data, uint32_t write_data, bool mem_read, bool mem_write);
 
+        // Whether access() can take this request now: its line already has an
+        // MSHR with room for another target, or an MSHR is free. The core
+        // retries later otherwise
+        bool canAccept(uint32_t address, bool mem_write);
+
+        // Advances outstanding requests by a cycle, running the ones due
         void tick();
 
+        // Requests that completed in the last tick(), in the order their
+        // lines became due; loads carry the word read
+        const std::vector<MSHRTarget> &completions() const { return completed; }
+
+        // Backing store, for untimed (functional) simulation
+        PagedMemory &backing() { return mem; }
+
         // given a starting address and number of words from that starting address
         // this function prints int values at the memory
         void print(uint32_t address, int num_words) {
             for (uint32_t i = address; i < address+num_words; ++i) {
-                std::cout<< "MEM[" << std::hex << i << "]: " << mem[i] << std::dec << "\n";
+                std::cout<< "MEM[" << std::hex << i << "]: " << mem.load(i*4) << std::dec << "\n";
             }
         }
 };
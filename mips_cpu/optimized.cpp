@@ -1,4 +1,3 @@
-
 #include "processor.h"
 #include <cstring>
 #include <iostream>
@@ -7,20 +6,37 @@
 #include <array>
 #include <cstdint>
 #include <tuple>
-
-const size_t instructionQueue_size = 30;
-const int reorder_buffer_size = 50;
-const int load_store_buffer_size = 20;
-const int sheduleing_queue_size = 50;
-const int scalar_size = 1;
+#include <algorithm>
+#include <climits>
+
+// Compile-time shape of the out-of-order core. Every structure size and the
+// superscalar width are template parameters, so the per-slot loops in
+// optimized_processor_advance unroll and the modulo arithmetic folds.
+template <int Width, size_t IQSize = 30, int ROBSize = 50, int LSBSize = 20, int SQSize = 50>
+struct CoreConfig {
+    static const int scalar_size = Width;
+    static const size_t instructionQueue_size = IQSize;
+    static const int reorder_buffer_size = ROBSize;
+    static const int load_store_buffer_size = LSBSize;
+    static const int sheduleing_queue_size = SQSize;
+    // Result tags below this name scheduling queue entries, the ones from
+    // here up load/store buffer entries, and from hi_tag_base the HI half of
+    // a mult/div (whose LO is tagged with its queue entry)
+    static const int load_tag_base = (SQSize + 63) / 64 * 64;
+    static const int hi_tag_base = load_tag_base + (LSBSize + 63) / 64 * 64;
+};
 
 
+template <size_t instructionQueue_size>
 class InstructionQueue {
     private:
         struct InstructionEntry {
             uint32_t instruction;
             uint32_t pc;
             bool     pending; // Valid bit
+            uint32_t predicted_next_pc;
+            bool taken;
+            BranchPredictor::Snapshot predictor;    // right after predicting it
         };
     
         std::vector<InstructionEntry> instruction_queue; // storage
@@ -34,9 +50,10 @@ class InstructionQueue {
         }
     
 
-        bool put(uint32_t instruction, uint32_t pc, bool pending) {
+        bool put(uint32_t instruction, uint32_t pc, bool pending, uint32_t predicted_next_pc, bool taken,
+                 const BranchPredictor::Snapshot &predictor) {
             if ((tail + 1) % max_size != head) {
-                instruction_queue[tail] = {instruction, pc, pending};
+                instruction_queue[tail] = {instruction, pc, pending, predicted_next_pc, taken, predictor};
                 tail = (tail + 1) % max_size;
                 return true;
             }
@@ -57,23 +74,60 @@ class InstructionQueue {
     
         bool is_full()  const { return (tail + 1) % max_size == head; }
         bool is_empty() const { return tail == head || instruction_queue[head].pending;}
+        bool has_entries() const { return tail != head; }
     
         // Retrieve & remove the front instruction if it's no longer pending
-        std::pair<uint32_t, uint32_t> get() {
+        std::tuple<uint32_t, uint32_t, uint32_t, bool, BranchPredictor::Snapshot> get() {
             if (tail != head && !instruction_queue[head].pending) {
-                auto front = instruction_queue[head];
-                head = (head + 1) % max_size;
-                return {front.instruction, front.pc};
+            auto front = instruction_queue[head];
+            head = (head + 1) % max_size;
+            return {front.instruction, front.pc, front.predicted_next_pc, front.taken, front.predictor};
             }
-            return {0, 0};
+            return {0, 0, 0, false, BranchPredictor::Snapshot()};
         }
-    
-    
         void flush() {
             head = tail = 0;
         }
     };
     
+    // Consumers waiting on each result tag, recorded as they are dispatched,
+    // so a result visits only its own waiters instead of every entry of the
+    // structure. A consumer may stay recorded under a tag it no longer waits
+    // on (a register renamed again first), so wake-ups re-check the tag
+    class DependentsList {
+    private:
+        std::vector<std::vector<int> > waiters;    // by tag, grown on demand
+
+    public:
+        void add(int tag, int consumer) {
+            if (tag < 0) {
+                return;     // filled in some other way, not by a broadcast
+            }
+            if (tag >= (int)waiters.size()) {
+                waiters.resize(tag + 1);
+            }
+            waiters[tag].push_back(consumer);
+        }
+
+        // Passes each consumer waiting on tag to wake, then forgets them
+        template <class F>
+        void wake(int tag, F wake) {
+            if (tag < 0 || tag >= (int)waiters.size()) {
+                return;
+            }
+            for (int consumer : waiters[tag]) {
+                wake(consumer);
+            }
+            waiters[tag].clear();
+        }
+
+        void flush() {
+            for (auto &list : waiters) {
+                list.clear();
+            }
+        }
+    };
+
     struct PredicativeReg {
         bool valid;      // Valid bit
         int tag;         // Tag (integer)
@@ -82,12 +136,13 @@ class InstructionQueue {
     
     class PredicativeRegisterFile {
     private:
-        std::vector<PredicativeReg> registers; // 32 entries
+        std::vector<PredicativeReg> registers; // NUM_REGS entries, HI and LO included
+        DependentsList waiting;                 // register numbers by tag
     
     public:
         PredicativeRegisterFile() {
-            registers.resize(32);
-            for (int i = 0; i < 32; ++i) {
+            registers.resize(NUM_REGS);
+            for (int i = 0; i < NUM_REGS; ++i) {
                 registers[i].valid = true; // Initialize valid bit to false
                 registers[i].tag = 0;       // Initialize tag to 0
                 registers[i].value = 0;     // Initialize value to 0
@@ -104,6 +159,9 @@ class InstructionQueue {
             registers[index].valid = valid;
             registers[index].tag = tag;
             registers[index].value = value;
+            if (!valid) {
+                waiting.add(tag, index);
+            }
         }
     
         // Check if a register is valid
@@ -113,17 +171,18 @@ class InstructionQueue {
     
         // Update a register based on tag and value
         void update(int tag, int32_t value) {
-            for (auto& reg : registers) {
+            waiting.wake(tag, [&](int index) {
+                PredicativeReg &reg = registers[index];
                 if (!reg.valid && reg.tag == tag) {
                     reg.value = value;
                     reg.valid = true;
-                    return; 
                 }
-            }
+            });
         }
         void updateTag(int index, int tag) {
             registers[index].tag = tag;   // Update the tag
             registers[index].valid = false; // Set valid bit to false
+            waiting.add(tag, index);
         }
 
         void syncWithRealRegisters(Registers& realRegFile) {
@@ -133,6 +192,7 @@ class InstructionQueue {
                 registers[i].value = read_data_1; // Assign the value to the predicative register
                 registers[i].valid = true;       // Set the valid bit to true
             }
+            waiting.flush();
         }
 
         
@@ -143,6 +203,8 @@ class InstructionQueue {
 
 
 
+
+template <int reorder_buffer_size>
 class ReorderBuffer {
 private:
     static const int MAX_SIZE = reorder_buffer_size; // Maximum size of the ROB
@@ -159,32 +221,59 @@ private:
         bool jump;             // Jump flag
         bool flush;
         bool pending;
+        bool hilo;             // mult/div: also writes hi to HI
+        uint32_t hi;
+        BranchKind kind;       // what the predictor is trained as
     };
 
     std::array<ROBEntry, MAX_SIZE> buffer; // Circular queue
     int head; // Pointer to the next entry to be committed
     int tail; // Pointer to the next available slot for adding instructions
     int count; // Number of entries currently in the ROB
+    uint64_t committed; // Instructions committed so far (never reset)
 
 public:
-    ReorderBuffer() : head(0), tail(0), count(0) {}
+    ReorderBuffer() : head(0), tail(0), count(0), committed(0) {}
 
     // Check if there is space in the ROB
     bool hasSpace() const {
         return count < MAX_SIZE;
     }
-    int commit() {        
+
+    bool isEmpty() const {
+        return count == 0;
+    }
+
+    uint64_t committedCount() const {
+        return committed;
+    }
+
+    // True if update(index, value, false, address, true) would modify the entry
+    bool storeUpdateChanges(int index, uint32_t value, uint32_t address) const {
+        const ROBEntry &entry = buffer[index];
+        return entry.value != value || !entry.execute || entry.jump || entry.address != address;
+    }
+
+    // True if the head entry can commit (getFrontEntryWithIndex finds it)
+    bool headReady() const {
+        return count > 0 && buffer[head].execute && !buffer[head].pending;
+    }
+    int commit(BranchPredictor& branch_predictor) {        
         // Move head pointer to the next entry
         int commitIdx = head;
+        uint32_t pc = buffer[head].pc;
+        branch_predictor.update(pc, buffer[head].kind, buffer[head].jump, buffer[head].address, buffer[head].flush);
+        // std::cout << "PC: 0x" << std::hex << pc << std::dec << std::endl;
         head = (head + 1) % MAX_SIZE;
         count--;
+        committed++;
         return commitIdx; // Successfully committed an entry
     }
 
     // Add a new entry to the ROB
     int put(int dest_reg, bool halfword, bool byte, uint32_t pc, 
         bool mem_write , bool reg_write, bool jump, 
-        bool execute, uint32_t value, uint32_t address) {
+        bool execute, uint32_t value, uint32_t address, BranchKind kind) {
 
         buffer[tail] = {
             .execute = execute,  
@@ -199,6 +288,9 @@ public:
             .jump = jump,
             .flush = false,
             .pending = false,
+            .hilo = false,
+            .hi = 0,
+            .kind = kind,
         };
 
         int index = tail; // Store the current tail index
@@ -208,17 +300,29 @@ public:
     }
 
     // Update an entry in the ROB
-    void update(int index, uint32_t value, bool jump, uint32_t address, bool flush, bool update_address) {
+    void update(int index, uint32_t value, bool jump, uint32_t address, bool update_address) {
         buffer[index].value = value; 
         buffer[index].execute = true; 
-        buffer[index].jump = jump; 
+        // std::cout << "Jump: " << jump << ", Buffer Jump: " << buffer[index].jump << ", Address: " << std::hex << buffer[index].address << std::endl;
+        if (buffer[index].jump != jump){
+            buffer[index].jump = jump;
+            buffer[index].flush = true;
+        }
+
         if (update_address){
+            if(buffer[index].address != address && jump){
+                buffer[index].flush = true;
+            }
             buffer[index].address = address;
         }
-        buffer[index].flush = flush;
         buffer[index].execute = true;
     }
 
+    // HI result of a mult/div; update() delivers its LO
+    void updateHi(int index, uint32_t hi) {
+        buffer[index].hilo = true;
+        buffer[index].hi = hi;
+    }
 
     void updatePendingBit(int index) {
         if (index >= 0 && index < MAX_SIZE) {
@@ -249,6 +353,7 @@ public:
 };
 
 
+template <int load_store_buffer_size>
 class LoadStoreBuffer {
 private:
     static const int MAX_SIZE = load_store_buffer_size; // Maximum size of the Load/Store Buffer
@@ -269,6 +374,7 @@ private:
     };
 
     std::array<LSBEntry, MAX_SIZE> buffer; // Circular array
+    DependentsList waiting; // entry*2 for the address, entry*2+1 for the store value
     int head; // Pointer to the next entry to commit
     int tail; // Pointer to the next available slot for adding instructions
     int count; // Number of entries currently in the buffer
@@ -299,6 +405,10 @@ public:
         };
 
         int index = tail; // Store the current tail index
+        waiting.add(tag_address, index * 2);
+        if (!valid_value) {
+            waiting.add(tag_value, index * 2 + 1);
+        }
         tail = (tail + 1) % MAX_SIZE; // Move tail pointer to the next slot
         count++;
         return index; // Return the index where the entry was added
@@ -324,23 +434,25 @@ public:
     }
 
     void update(int tag, uint32_t value) {
-        for (int i = 0; i < MAX_SIZE; ++i) {
-            if (buffer[i].tag_address == tag && !buffer[i].valid_address) {
-                buffer[i].address = value;
-                buffer[i].valid_address = true;
+        waiting.wake(tag, [&](int slot) {
+            LSBEntry &entry = buffer[slot / 2];
+            if (slot % 2 == 0 && entry.tag_address == tag && !entry.valid_address) {
+                entry.address = value;
+                entry.valid_address = true;
             }
             
-            if (buffer[i].tag_value == tag && !buffer[i].valid_value) {
-                buffer[i].value = value;
-                buffer[i].valid_value = true;
+            if (slot % 2 == 1 && entry.tag_value == tag && !entry.valid_value) {
+                entry.value = value;
+                entry.valid_value = true;
             }
-        }
+        });
     }
 
-    void processValidMemoryInstructions(ReorderBuffer& reorder_buffer) {
+    template <class ROB>
+    void processValidMemoryInstructions(ROB& reorder_buffer) {
         for (int i = head, count = 0; count < this->count; i = (i + 1) % MAX_SIZE, ++count) {
             if (buffer[i].execute & buffer[i].is_store){
-                reorder_buffer.update(buffer[i].ROBID, buffer[i].value, false, buffer[i].address, false, true);
+                reorder_buffer.update(buffer[i].ROBID, buffer[i].value, false, buffer[i].address, true);
             }
         }
     }
@@ -350,37 +462,53 @@ public:
                 if (buffer[i].is_store && buffer[i].valid_address && buffer[i].valid_value){
                 buffer[i].execute = true;
             }
-            if (!buffer[i].is_store && buffer[i].valid_address && !buffer[i].execute) { 
-                bool can_execute = true;
-                uint32_t load_start = buffer[i].address;
-                uint32_t load_end = load_start + (buffer[i].byte ? 1 : (buffer[i].halfword ? 2 : 4));
-                
-                for (int j = head; j != i; j = (j + 1) % MAX_SIZE) { 
-                    if (buffer[j].is_store) {
-                        if (!buffer[j].valid_address) {
-                            can_execute = false;
-                            break; 
-                        }
-                        
-                        uint32_t store_start = buffer[j].address;
-                        uint32_t store_end = store_start + (buffer[j].byte ? 1 : (buffer[j].halfword ? 2 : 4));
-                                               
-                        if (!(store_end <= load_start || store_start >= load_end)) { 
-                            if (!buffer[j].valid_value) {
-                                can_execute = false;
-                                break; 
-                            } 
-                            can_execute = false;
-                            break;
-                        }
-                    }
+            if (!buffer[i].is_store && buffer[i].valid_address && !buffer[i].execute && loadCanExecute(i)) { 
+                buffer[i].execute = true;
+            }
+        }
+    }
+
+    // A load may go once every older store has its address and none overlaps it
+    bool loadCanExecute(int i) const {
+        uint32_t load_start = buffer[i].address;
+        uint32_t load_end = load_start + (buffer[i].byte ? 1 : (buffer[i].halfword ? 2 : 4));
+
+        for (int j = head; j != i; j = (j + 1) % MAX_SIZE) { 
+            if (buffer[j].is_store) {
+                if (!buffer[j].valid_address) {
+                    return false;
                 }
                 
-                if (can_execute) {
-                    buffer[i].execute = true;
+                uint32_t store_start = buffer[j].address;
+                uint32_t store_end = store_start + (buffer[j].byte ? 1 : (buffer[j].halfword ? 2 : 4));
+                                       
+                if (!(store_end <= load_start || store_start >= load_end)) { 
+                    return false;
                 }
             }
         }
+        return true;
+    }
+
+    // True if the load stage would change anything this cycle, including
+    // the ROB updates processValidMemoryInstructions repeats for stores
+    template <class ROB>
+    bool canProgress(const ROB& reorder_buffer) const {
+        if (count > 0 && buffer[head].complete) {
+            return true;
+        }
+        for (int i = head, count = 0; count < this->count; i = (i + 1) % MAX_SIZE, ++count) {
+            const LSBEntry &entry = buffer[i];
+            if (entry.is_store) {
+                if (entry.execute ? reorder_buffer.storeUpdateChanges(entry.ROBID, entry.value, entry.address) :
+                                    entry.valid_address && entry.valid_value) {
+                    return true;
+                }
+            } else if (entry.execute ? !entry.complete && !entry.pending : entry.valid_address && loadCanExecute(i)) {
+                return true;
+            }
+        }
+        return false;
     }
 
     std::tuple<bool, uint32_t, bool, bool, int, int, bool, uint32_t> getExecutableLoad() {
@@ -440,21 +568,26 @@ public:
         for (auto& entry : buffer) {
             entry = {false, false, -1, -1, 0, 0, false, false, false, -1, false, false};
         }
+        waiting.flush();
     }
 
 };
 
 
 
+template <int sheduleing_queue_size>
 class SchedulingQueue {
     private:
         static const int MAX_SIZE = sheduleing_queue_size; // Maximum size of the Scheduling Queue
+        static const int MASK_WORDS = (MAX_SIZE + 63) / 64;
         
     public:
         // Control flags and instruction details bundled together
         struct InstructionDetails {
             unsigned ALU_op;   // ALU operation code
             bool memory;       // Memory operation
+            bool load;         // 1 if lw, lh or lb
+            bool hilo;         // 1 if mult/div
             bool jump_reg;     // 1 if jr
             bool link;         // 1 if jal
             bool branch;       // 1 if branch
@@ -462,11 +595,12 @@ class SchedulingQueue {
             int opcode;        // Instruction opcode (6 bits in MIPS)
             int funct;         // Function code (6 bits in MIPS)
             int shamt;         // Shift amount (5 bits in MIPS)
+            int ALU_control;   // ALU control inputs, from predecode
+            int fu_class;      // FU_* unit that executes it
         };
         
     private:
         struct SQEntry {
-            bool allocated;           // Indicates if the entry is allocated
             bool valid1;              // Valid bit for the first value
             int tag1;                 // Tag for the first value
             uint32_t value1;          // Value for the first operand
@@ -478,143 +612,251 @@ class SchedulingQueue {
         };
     
         std::array<SQEntry, MAX_SIZE> buffer; // Array to store the scheduling queue entries
-    
-    public:
-        SchedulingQueue() {
-            for (int i = 0; i < MAX_SIZE; ++i) {
-                buffer[i] = {
-                    .allocated = false,
-                    .valid1 = false,
-                    .tag1 = -1,
-                    .value1 = 0,
-                    .valid2 = false,
-                    .tag2 = -1,
-                    .value2 = 0,
-                    .ROBID = 0,
-                    .inst = {0, 0, 0, 0, 0, 0, 0, 0, 0}  
-                };
+
+        // One bit per entry: free entries, and allocated ones with both
+        // operands. Allocation and issue take the lowest set bit, the same
+        // entry the old linear scans found
+        typedef std::array<uint64_t, MASK_WORDS> Mask;
+        Mask free_mask;
+        Mask ready_mask;
+        std::array<Mask, FU_CLASSES> class_mask;   // entries by the unit they need
+        Mask load_mask;                 // entries holding a load
+        std::array<Mask, MAX_SIZE> older;   // age matrix: the entries dispatched before each one
+        DependentsList waiting;     // entry*2 + operand (0 or 1) by tag
+
+        // Bits of word w that stand for real entries
+        static uint64_t wordBits(int w) {
+            return w < MAX_SIZE / 64 ? ~0ull : (1ull << (MAX_SIZE % 64)) - 1;
+        }
+        static int lowestSet(const Mask &mask) {
+            for (int w = 0; w < MASK_WORDS; w++) {
+                if (mask[w]) return w * 64 + __builtin_ctzll(mask[w]);
+            }
+            return -1;
+        }
+        static void setBit(Mask &mask, int i) { mask[i / 64] |= 1ull << (i % 64); }
+        static void clearBit(Mask &mask, int i) { mask[i / 64] &= ~(1ull << (i % 64)); }
+        static void putBit(Mask &mask, int i, bool on) { on ? setBit(mask, i) : clearBit(mask, i); }
+        static Mask both(const Mask &a, const Mask &b) {
+            Mask result;
+            for (int w = 0; w < MASK_WORDS; w++) result[w] = a[w] & b[w];
+            return result;
+        }
+
+        // The candidate no other candidate is older than, or -1 if none
+        int oldest(const Mask &candidates) const {
+            for (int w = 0; w < MASK_WORDS; w++) {
+                for (uint64_t bits = candidates[w]; bits; bits &= bits - 1) {
+                    int i = w * 64 + __builtin_ctzll(bits);
+                    if (lowestSet(both(older[i], candidates)) < 0) {
+                        return i;
+                    }
+                }
             }
+            return -1;
         }
     
+    public:
+        SchedulingQueue() { flush(); }
+    
         // Check if there is an unallocated entry
         bool hasUnallocatedEntry() const {
-            for (const auto& entry : buffer) {
-                if (!entry.allocated) {
-                    return true;
-                }
-            }
-            return false;
+            return lowestSet(free_mask) >= 0;
         }
 
+        // True if some entry has both operands and can execute
+        bool hasReadyEntry() const {
+            return lowestSet(ready_mask) >= 0;
+        }
 
         // Allocate an entry with bundled instruction details
         int allocateEntry(int tag1, uint32_t value1, bool valid1, int tag2, uint32_t value2, bool valid2, 
                           const InstructionDetails& inst, int ROBID) {
-            for (int i = 0; i < MAX_SIZE; ++i) {
-                if (!buffer[i].allocated) {
-                    buffer[i].allocated = true;
-                    buffer[i].valid1 = valid1;
-                    buffer[i].tag1 = tag1;
-                    buffer[i].value1 = value1;
-                    buffer[i].valid2 = valid2;
-                    buffer[i].tag2 = tag2;
-                    buffer[i].value2 = value2;
-                    buffer[i].inst = inst;
-                    buffer[i].ROBID = ROBID;
-                    return i; 
-                }
+            int i = lowestSet(free_mask);
+            if (i < 0) {
+                return -1;
+            }
+            clearBit(free_mask, i);
+            for (int w = 0; w < MASK_WORDS; w++) {
+                older[i][w] = ~free_mask[w] & wordBits(w);
+            }
+            clearBit(older[i], i);
+            for (int c = 0; c < FU_CLASSES; c++) {
+                putBit(class_mask[c], i, inst.fu_class == c);
+            }
+            putBit(load_mask, i, inst.load);
+            buffer[i].valid1 = valid1;
+            buffer[i].tag1 = tag1;
+            buffer[i].value1 = value1;
+            buffer[i].valid2 = valid2;
+            buffer[i].tag2 = tag2;
+            buffer[i].value2 = value2;
+            buffer[i].inst = inst;
+            buffer[i].ROBID = ROBID;
+            if (valid1 && valid2) {
+                setBit(ready_mask, i);
             }
-            return -1; 
+            if (!valid1) {
+                waiting.add(tag1, i * 2);
+            }
+            if (!valid2) {
+                waiting.add(tag2, i * 2 + 1);
+            }
+            return i; 
         }
     
+        // Issues a ready entry for one of the FU classes (an FU_* bitmask),
+        // chosen by policy. The entry stays allocated until release()
         // Return a tuple that includes the InstructionDetails
-        std::tuple<bool, uint32_t, uint32_t, int, InstructionDetails, int> deallocateEntry() {
-            for (int i = 0; i < MAX_SIZE; ++i) {
-                if (buffer[i].allocated && buffer[i].valid1 && buffer[i].valid2) {
-                    uint32_t value1 = buffer[i].value1;
-                    uint32_t value2 = buffer[i].value2;
-                    int ROBID = buffer[i].ROBID;
-                    InstructionDetails inst = buffer[i].inst;
-                    
-                    // Deallocate the entry
-                    buffer[i].allocated = false;
-                    buffer[i].valid1 = false;
-                    buffer[i].tag1 = -1;
-                    buffer[i].valid2 = false;
-                    buffer[i].tag2 = -1;
-                    buffer[i].ROBID = 0;
-                    buffer[i].inst = {0, 0, 0, 0, 0, 0, 0, 0, 0};
-                    
-                    return {true, value1, value2, ROBID, inst, i};
+        std::tuple<bool, uint32_t, uint32_t, int, InstructionDetails, int> deallocateEntry(IssuePolicy policy, unsigned classes) {
+            Mask candidates = ready_mask;
+            if (classes != FU_ALL) {
+                Mask servable = {};
+                for (int c = 0; c < FU_CLASSES; c++) {
+                    if (classes & (1u << c)) {
+                        for (int w = 0; w < MASK_WORDS; w++) servable[w] |= class_mask[c][w];
+                    }
+                }
+                candidates = both(candidates, servable);
+            }
+            if (policy == ISSUE_BRANCH_FIRST || policy == ISSUE_LOAD_FIRST) {
+                Mask preferred = both(candidates, policy == ISSUE_BRANCH_FIRST ? class_mask[FU_BRANCH] : load_mask);
+                if (lowestSet(preferred) >= 0) {
+                    candidates = preferred;
                 }
             }
+            int i = policy == ISSUE_INDEX ? lowestSet(candidates) : oldest(candidates);
+            if (i < 0) {
+                InstructionDetails emptyInst = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+                return {false, 0, 0, 0, emptyInst, -1};
+            }
+            clearBit(ready_mask, i);
+            return {true, buffer[i].value1, buffer[i].value2, buffer[i].ROBID, buffer[i].inst, i};
+        }
 
-            InstructionDetails emptyInst = {0, 0, 0, 0, 0, 0, 0, 0, 0};
-            return {false, 0, 0, 0, emptyInst, -1};
+        // Frees an issued entry once its result is out. Its index is the
+        // result tag, so it cannot be handed out again before then
+        void release(int i) {
+            setBit(free_mask, i);
+            for (Mask &row : older) {
+                clearBit(row, i);
+            }
         }
     
 
+        // Wakes up the entries waiting on tag
         void update(int tag, uint32_t value) {
-            for (int i = 0; i < MAX_SIZE; ++i) {
-                if (buffer[i].allocated) {
-                    if (buffer[i].tag1 == tag && !buffer[i].valid1) {
-                        buffer[i].value1 = value;
-                        buffer[i].valid1 = true;
-                    }
-                    
-                    if (buffer[i].tag2 == tag && !buffer[i].valid2) {
-                        buffer[i].value2 = value;
-                        buffer[i].valid2 = true;
-                    }
+            waiting.wake(tag, [&](int slot) {
+                SQEntry &entry = buffer[slot / 2];
+                if (slot % 2 == 0 && entry.tag1 == tag && !entry.valid1) {
+                    entry.value1 = value;
+                    entry.valid1 = true;
                 }
-            }
+                
+                if (slot % 2 == 1 && entry.tag2 == tag && !entry.valid2) {
+                    entry.value2 = value;
+                    entry.valid2 = true;
+                }
+                if (entry.valid1 && entry.valid2) {
+                    setBit(ready_mask, slot / 2);
+                }
+            });
         }
 
         void flush() {
-            for (auto& entry : buffer) {
-                entry = {
-                    .allocated = false,
-                    .valid1 = false,
-                    .tag1 = -1,
-                    .value1 = 0,
-                    .valid2 = false,
-                    .tag2 = -1,
-                    .value2 = 0,
-                    .ROBID = 0,
-                    .inst = {0, 0, 0, 0, 0, 0, 0, 0, 0}
-                };
+            for (int w = 0; w < MASK_WORDS; w++) {
+                free_mask[w] = wordBits(w);
+                ready_mask[w] = 0;
+                load_mask[w] = 0;
+                for (Mask &mask : class_mask) mask[w] = 0;
             }
+            for (Mask &row : older) {
+                row.fill(0);
+            }
+            waiting.flush();
         }
     };
 
 
 
-void Processor:: optimized_processor_advance(){
-    static uint32_t current_pc = 0;
-    static InstructionQueue instruction_queue;
-    static PredicativeRegisterFile predicative_reg_file; 
-    static ReorderBuffer reorder_buffer;
-    static LoadStoreBuffer load_store_buffer;
-    static SchedulingQueue scheduling_queue;
 
-    memory->tick();
-    auto &entries = memory->mshr.entries;
 
+// Everything the out-of-order core carries from one cycle to the next
+template <class Config>
+struct OptimizedCore : OutOfOrderCore {
+    uint32_t current_pc = 0;    // fetch PC
+    InstructionQueue<Config::instructionQueue_size> instruction_queue;
+    PredicativeRegisterFile predicative_reg_file;
+    ReorderBuffer<Config::reorder_buffer_size> reorder_buffer;
+    LoadStoreBuffer<Config::load_store_buffer_size> load_store_buffer;
+    SchedulingQueue<Config::sheduleing_queue_size> scheduling_queue;
 
+    // An issued instruction whose result is not out on a result bus yet
+    struct Executing {
+        uint64_t due;           // cycle its unit's latency is up
+        int index;              // result tag
+        int robID;
+        typename SchedulingQueue<Config::sheduleing_queue_size>::InstructionDetails control;
+        uint32_t result;
+        uint32_t hi;            // HI of a mult/div
+        uint32_t zero;
+    };
+    uint64_t cycle = 0;                 // advance()s so far, idle skips included
+    std::vector<Executing> executing;   // in issue order
+    std::vector<uint64_t> port_busy;    // per port, the cycle an unpipelined unit frees up
+
+    // Squashed work leaves the units with the queues
+    void flushUnits() {
+        executing.clear();
+        std::fill(port_busy.begin(), port_busy.end(), 0);
+    }
 
-    size_t i = 0;
-    while (i < entries.size()) {
-        auto &entry = entries[i];
-        if (entry.success) {
-            if (entry.is_write) {
-                int index = reorder_buffer.commit();
-                load_store_buffer.commitByROBID(index);
-            }
-            load_store_buffer.resolvePendingState(entry.address, entry.write_value);
-            instruction_queue.resolvePendingAddress(entry.address, entry.write_value);
-            entries.erase(entries.begin() + i);
+    // True if no stage can change anything until a memory request completes:
+    // nothing to commit, load, execute, decode or fetch
+    bool stalled(bool fetch_enabled) const {
+        bool can_decode = !instruction_queue.is_empty() && reorder_buffer.hasSpace() &&
+                          scheduling_queue.hasUnallocatedEntry() && load_store_buffer.hasSpace();
+        return !reorder_buffer.headReady() && !load_store_buffer.canProgress(reorder_buffer) && !scheduling_queue.hasReadyEntry() &&
+               executing.empty() && !can_decode && (instruction_queue.is_full() || !fetch_enabled);
+    }
+};
+
+template <class Config>
+void Processor::optimized_processor_advance(){
+    const int scalar_size = Config::scalar_size;
+    OptimizedCore<Config> &core = static_cast<OptimizedCore<Config> &>(*ooo_core);
+    uint32_t &current_pc = core.current_pc;
+    auto &instruction_queue = core.instruction_queue;
+    auto &predicative_reg_file = core.predicative_reg_file;
+    auto &reorder_buffer = core.reorder_buffer;
+    auto &load_store_buffer = core.load_store_buffer;
+    auto &scheduling_queue = core.scheduling_queue;
+
+    core.cycle++;
+    if (restart_core) {
+        // Start over at the architectural PC with empty queues (sampled runs)
+        instruction_queue.flush();
+        reorder_buffer.flush();
+        load_store_buffer.flush();
+        scheduling_queue.flush();
+        core.flushUnits();
+        memory->flushRequests();
+        predicative_reg_file.syncWithRealRegisters(regfile);
+        branch_predictor.flush();
+        current_pc = regfile.pc;
+        restart_core = false;
+    }
+
+    // branch_predictor.printEntriesWithTarget();
+    memory->tick();
+    // memory->mshr.print();
+    for (const MSHRTarget &done : memory->completions()) {
+        if (done.is_write) {
+            int index = reorder_buffer.commit(branch_predictor);
+            load_store_buffer.commitByROBID(index);
         } else {
-            ++i;
+            load_store_buffer.resolvePendingState(done.address, done.value);
+            instruction_queue.resolvePendingAddress(done.address, done.value);
         }
     }
 
@@ -630,6 +872,10 @@ for (int i = 0; i < scalar_size; i++){
             if (entry.mem_write){   
                 uint32_t read_data_mem;
                 uint32_t write_data_mem = entry.value;
+                // No free MSHR: the store waits at the head
+                if (!memory->canAccept(entry.address, true)) {
+                    break;
+                }
                 if(!(memory->access(entry.address, read_data_mem, write_data_mem, false, true))){
                     reorder_buffer.updatePendingBit(index);
                     break;
@@ -641,16 +887,25 @@ for (int i = 0; i < scalar_size; i++){
                 uint32_t read_data_2 = 0;
                 regfile.access(0, 0, read_data_1, read_data_2, entry.dest_reg, true, entry.value);
             }
+            if (entry.hilo) {
+                uint32_t read_data_1 = 0;
+                uint32_t read_data_2 = 0;
+                regfile.access(0, 0, read_data_1, read_data_2, REG_HI, true, entry.hi);
+            }
             if(entry.flush){
+                reorder_buffer.commit(branch_predictor);
+                branch_predictor.flush();
                 instruction_queue.flush();
                 predicative_reg_file.syncWithRealRegisters(regfile);
                 reorder_buffer.flush();
                 load_store_buffer.flush();
                 scheduling_queue.flush();
+                core.flushUnits();
+                memory->squashRequests();
                 current_pc = entry.address;
-                memory->mshr.flush();
+                regfile.pc = entry.pc;
             }else{
-            int commitIndex = reorder_buffer.commit();
+            int commitIndex = reorder_buffer.commit(branch_predictor);
             load_store_buffer.commitByROBID(commitIndex);
             }
             regfile.pc = entry.pc;
@@ -666,16 +921,19 @@ for (int i = 0; i < scalar_size; i++){
     load_store_buffer.updateExecutionBit();
     load_store_buffer.processValidMemoryInstructions(reorder_buffer);
     auto [success, address, halfword, byte, index, ROBID, valid_value, value] = load_store_buffer.getExecutableLoad();
+    if (success && !valid_value && !memory->canAccept(address, false)) {
+        break;
+    }
     if (success){
         uint32_t read_data_mem = value;
         uint32_t final_value = 0;
         if (valid_value||memory->access(address, read_data_mem, 0, true, false)){
             final_value = load_store_buffer.resolveStoreValue(index, read_data_mem);
             final_value &= control.halfword ? 0xffff : control.byte ? 0xff : 0xffffffff;
-            load_store_buffer.update(index + 64, final_value);
-            scheduling_queue.update(index + 64, final_value);
-            predicative_reg_file.update(index + 64, final_value);
-            reorder_buffer.update(ROBID, final_value, false, 0, false, false);
+            load_store_buffer.update(index + Config::load_tag_base, final_value);
+            scheduling_queue.update(index + Config::load_tag_base, final_value);
+            predicative_reg_file.update(index + Config::load_tag_base, final_value);
+            reorder_buffer.update(ROBID, final_value, false, 0, false);
         }else{
             load_store_buffer.updatePendingBit(index);
         }
@@ -685,32 +943,80 @@ for (int i = 0; i < scalar_size; i++){
 }
 
 
-for (int i = 0; i < scalar_size; i++){
 {
-    // execute 
-    auto [success, operand1, operand2, robID, control, index] = scheduling_queue.deallocateEntry();
-    if (success){
-        alu.generate_control_inputs(control.ALU_op, control.funct, control.opcode);
-        uint32_t alu_zero = 0;
-        uint32_t alu_result = alu.execute(operand1, operand2, alu_zero);
+    // execute: one instruction per issue port, its result broadcast on a
+    // result bus once its unit's latency is up
+    typedef typename OptimizedCore<Config>::Executing Executing;
+    auto writeback = [&](const Executing &done) {
+        const auto &control = done.control;
+        scheduling_queue.release(done.index);
         // update buffer 
-        predicative_reg_file.update(index, alu_result);
-        load_store_buffer.update(index, alu_result);
-        scheduling_queue.update(index, alu_result);
-        if(control.jump_reg || control.branch){
-            if ((control.branch && !control.bne && alu_zero) || (control.branch && control.bne && !alu_zero)){
-                reorder_buffer.update(robID, 0, true, 0, true, false);
-            }else if(control.jump_reg){
-                reorder_buffer.update(robID, 0, true, alu_result, true, true);
+        predicative_reg_file.update(done.index, done.result);
+        load_store_buffer.update(done.index, done.result);
+        scheduling_queue.update(done.index, done.result);
+        if (control.hilo) {
+            int hi_tag = done.index + Config::hi_tag_base;
+            predicative_reg_file.update(hi_tag, done.hi);
+            load_store_buffer.update(hi_tag, done.hi);
+            scheduling_queue.update(hi_tag, done.hi);
+            reorder_buffer.updateHi(done.robID, done.hi);
+        }
+        if(control.branch){
+            if ((control.branch && !control.bne && done.zero) || (control.branch && control.bne && !done.zero)){
+                reorder_buffer.update(done.robID, 0, true, 0, false);
             }else{
-                reorder_buffer.update(robID, 0, false, alu_result, false, true);
+                // std::cout << "Branch not taken" << std::endl;
+                reorder_buffer.update(done.robID, 0, false, done.result, false);
             }
-        }else if (!control.memory){
-            reorder_buffer.update(robID, alu_result, false, 0, false, false);
+        }else if(control.jump_reg){
+            reorder_buffer.update(done.robID, 0, true, done.result, true);
+        }
+        else if (!control.memory){
+            // jal was taken at decode; keep it that way
+            reorder_buffer.update(done.robID, done.result, control.link, 0, false);
         }
+    };
 
+    // Earlier multi-cycle results go out first, so dependents can issue now
+    int buses = units.result_buses ? units.result_buses : INT_MAX;
+    auto &executing = core.executing;
+    for (size_t r = 0; r < executing.size() && buses > 0; ) {
+        if (executing[r].due <= core.cycle) {
+            writeback(executing[r]);
+            executing.erase(executing.begin() + r);
+            buses--;
+        } else {
+            r++;
+        }
+    }
+
+    const int ports = units.ports.empty() ? scalar_size : units.ports.size();
+    core.port_busy.resize(ports, 0);
+    for (int p = 0; p < ports; p++){
+        if (core.port_busy[p] > core.cycle) {
+            continue;
+        }
+        auto [success, operand1, operand2, robID, control, index] =
+            scheduling_queue.deallocateEntry(issue_policy, units.ports.empty() ? FU_ALL : units.ports[p]);
+        if (success){
+            alu.set_control_inputs(control.ALU_control);
+            uint32_t alu_zero = 0;
+            uint32_t alu_result = alu.execute(operand1, operand2, alu_zero);
+            int latency = units.latency(control.fu_class, control.ALU_control);
+            Executing done = {core.cycle + latency - 1, index, robID, control, alu_result, alu.hi(), alu_zero};
+            if (!units.pipelined(control.fu_class, control.ALU_control)) {
+                core.port_busy[p] = core.cycle + latency;
+            }
+            if (latency <= 1 && buses > 0) {
+                writeback(done);
+                buses--;
+            } else {
+                // waits for its latency, or for a free result bus next cycle
+                done.due = std::max(done.due, core.cycle + 1);
+                executing.push_back(done);
+            }
+        }
     }
-}
 }
 
 
@@ -721,21 +1027,23 @@ for (int i = 0; i < scalar_size; i++){
         // decode into control signals
         uint32_t decode_instruction;
         uint32_t decode_pc;
-        std::pair<uint32_t, uint32_t> decoded = instruction_queue.get();
-        decode_instruction = decoded.first;
-        decode_pc = decoded.second;
-        control.decode(decode_instruction);
-
-        // extract rs, rt, rd, imm, funct 
-        int opcode = (decode_instruction >> 26) & 0x3f;
-        int rs = (decode_instruction >> 21) & 0x1f;
-        int rt = (decode_instruction >> 16) & 0x1f;
-        int rd = (decode_instruction >> 11) & 0x1f;
-        int shamt = (decode_instruction >> 6) & 0x1f;
-        int funct = decode_instruction & 0x3f;
-        uint32_t imm = (decode_instruction & 0xffff);
+        uint32_t predicted_next_pc;
+        bool taken;
+        std::tuple<uint32_t, uint32_t, uint32_t, bool, BranchPredictor::Snapshot> decoded = instruction_queue.get();
+        decode_instruction = std::get<0>(decoded);
+        decode_pc = std::get<1>(decoded);
+        predicted_next_pc = std::get<2>(decoded);
+        taken = std::get<3>(decoded);
+        const BranchPredictor::Snapshot &predictor_state = std::get<4>(decoded);
+        const DecodedInst &predecoded = memory->predecode.lookup(decode_pc, decode_instruction);
+        control = predecoded.control;
+
+        int opcode = predecoded.opcode;
+        int rs = predecoded.rs;
+        int rt = predecoded.rt;
+        int shamt = predecoded.shamt;
+        uint32_t imm = predecoded.imm;
         int addr = decode_instruction & 0x3ffffff;
-        imm = control.zero_extend ? imm : (imm >> 15) ? 0xffff0000 | imm : imm;
 
         //put instruction into reorder buffer
         int tag_1 = -1;
@@ -772,6 +1080,15 @@ for (int i = 0; i < scalar_size; i++){
             }
 
         }
+        else if (control.link){
+            // jal: the ALU adds up its return address
+            tag_1 = 0;
+            value_1 = decode_pc + 8;
+            valid_1 = true;
+            tag_2 = 0;
+            value_2 = 0;
+            valid_2 = true;
+        }
         else if (control.jump_reg){
             PredicativeReg reg_1 = predicative_reg_file.read(rs);
             tag_1 = reg_1.tag;
@@ -802,41 +1119,70 @@ for (int i = 0; i < scalar_size; i++){
         }
         
 
-        const SchedulingQueue::InstructionDetails control_detail = {
+        const typename SchedulingQueue<Config::sheduleing_queue_size>::InstructionDetails control_detail = {
             .ALU_op = control.ALU_op,
             .memory = control.mem_read || control.mem_write,
+            .load = control.mem_read != 0,
+            .hilo = control.hilo,
             .jump_reg = control.jump_reg,
             .link = control.link,
             .branch = control.branch,
             .bne = control.bne,
             .opcode = opcode,
-            .funct = funct,
-            .shamt = shamt
+            .funct = predecoded.funct,
+            .shamt = shamt,
+            .ALU_control = predecoded.ALU_control,
+            .fu_class = control.mem_read || control.mem_write ? FU_AGU :
+                        control.branch || control.jump_reg ? FU_BRANCH :
+                        control.hilo ? FU_MULDIV : FU_ALU
         };
 
-        if (control.jump && !control.jump_reg){
-            addr = ((decode_pc + 4)& 0xf0000000) & (addr << 2);
-            current_pc = addr;
-            instruction_queue.flush();
+        if (control.jump && !control.jump_reg && !control.branch){
+            addr = predecoded.jump_target;
+            if (predicted_next_pc != addr){
+                current_pc = addr;
+                instruction_queue.flush();
+                branch_predictor.repair(predictor_state);
+                if (!taken) {
+                    branch_predictor.jumpTaken(decode_pc, branchKind(predecoded), addr);
+                }
+                taken = true;
+            }
+            taken = true;
         }else if (control.branch){
-            addr = decode_pc + 4 + (imm << 2);
+            addr = predecoded.branch_target;
+            if (taken && addr != predicted_next_pc){
+                current_pc = addr;
+                instruction_queue.flush();
+                branch_predictor.repair(predictor_state);
+            }
         }
 
-        int ROBID = reorder_buffer.put(control.link ? 31 : control.reg_dest ? rd : rt, 
+        int ROBID = reorder_buffer.put(predecoded.write_reg, 
             control.halfword, control.byte, decode_pc, control.mem_write, control.reg_write, 
-            control.jump, control.jump && !control.jump_reg, control.link ? decode_pc + 8 : 0, addr);
-
+            taken, control.jump && !control.jump_reg, control.link ? decode_pc + 8 : 0, (control.jump_reg ? predicted_next_pc : (taken ? decode_pc + 4 : addr)),
+            branchKind(predecoded));
+        // std::cout << "Taken: " << taken 
+        //           << ", Decode PC: " << std::hex << decode_pc 
+        //           << ", Jump Reg: " << control.jump_reg 
+        //           << ", Predicted Next PC: " << predicted_next_pc 
+        //           << ", Decode PC + 4: " << (decode_pc + 4) 
+        //           << ", Addr: " << std::hex << addr 
+        //           << " , save addr " << std::hex << (control.jump_reg ? predicted_next_pc : (taken ? decode_pc + 4 : addr)) << std::endl;
         if (!control.jump || control.link || control.jump_reg){
             int index = scheduling_queue.allocateEntry(tag_1, value_1, valid_1, tag_2, value_2, valid_2, control_detail, ROBID);
             if (control.mem_read) {
-                index = load_store_buffer.put(false, index, -1, 0, control.byte, control.halfword, false, ROBID) + 64;
+                index = load_store_buffer.put(false, index, -1, 0, control.byte, control.halfword, false, ROBID) + Config::load_tag_base;
             } else if (control.mem_write) {
                 PredicativeReg reg3 = predicative_reg_file.read(rt);
                 load_store_buffer.put(reg3.valid, index, reg3.tag, reg3.value, control.byte, control.halfword, true, ROBID);
             }
 
             if (control.reg_write) {
-                predicative_reg_file.updateTag(control.link ? 31 : control.reg_dest ? rd : rt, index);
+                predicative_reg_file.updateTag(predecoded.write_reg, index);
+            }
+            if (control.hilo) {
+                predicative_reg_file.updateTag(REG_HI, index + Config::hi_tag_base);
             }
         }
         
@@ -847,23 +1193,74 @@ for (int i = 0; i < scalar_size; i++){
 }
 
 
-for (int i = 0; i < 1; i++){
+for (int i = 0; i < scalar_size; i++){
     {
         // fetch
         uint32_t fetch_instruction;
-        if (instruction_queue.is_full()){
+        if (instruction_queue.is_full() || !fetch_enabled){
             break;
         }
         
+        if (!memory->canAccept(current_pc, false)) {
+            break;
+        }
+        // Predecoded with the text, so fetch knows branches before their word arrives
+        const DecodedInst *known = memory->predecode.peek(current_pc);
+        auto[taken, predicted_target] = branch_predictor.predict(current_pc, known ? branchKind(*known) : BRANCH_NONE);
+        BranchPredictor::Snapshot predictor_state = branch_predictor.snapshot();
+
+        // std::cout << "Current PC: 0x" << std::hex << current_pc 
+        //           << ", Taken: " << taken 
+        //           << ", Predicted Target: 0x" << predicted_target 
+        //           << std::dec << std::endl;
         if(memory->access(current_pc, fetch_instruction, 0, 1, 0)){
-            instruction_queue.put(fetch_instruction, current_pc, false);
+            instruction_queue.put(fetch_instruction, current_pc, false, predicted_target, taken, predictor_state);
         }else{
-            instruction_queue.put(0, current_pc, true);
+            instruction_queue.put(0, current_pc, true, predicted_target, taken, predictor_state);
         }
-        current_pc += 4;
+        current_pc = taken? predicted_target: current_pc + 4;
     }
 
 }
 
-    
-}
\ No newline at end of file
+    core_committed = reorder_buffer.committedCount();
+    core_drained = reorder_buffer.isEmpty() && !instruction_queue.has_entries() && memory->mshr.empty();
+    core_fetch_pc = current_pc;
+}
+
+// While the core is stalled, the cycles until the next outstanding request
+// is due change nothing but the cycle count, so they are applied in one step
+template <class Config>
+uint64_t Processor::optimized_skip_idle(uint64_t max_cycles) {
+    OptimizedCore<Config> &core = static_cast<OptimizedCore<Config> &>(*ooo_core);
+    if (restart_core || !core.stalled(fetch_enabled)) {
+        return 0;
+    }
+    uint64_t cycles = std::min(memory->quietCycles(), max_cycles);
+    memory->skipCycles(cycles);
+    core.cycle += cycles;
+    return cycles;
+}
+
+template <class Config>
+void Processor::selectCore() {
+    optimized_advance = &Processor::optimized_processor_advance<Config>;
+    optimized_skip = &Processor::optimized_skip_idle<Config>;
+    ooo_core.reset(new OptimizedCore<Config>);
+}
+
+// Widths we build a specialized core for. Anything else is rejected by
+// main so a typo in a sweep does not silently fall back to another width.
+bool Processor::setWidth(int width) {
+    switch (width) {
+        case 1: selectCore<CoreConfig<1> >(); break;
+        case 2: selectCore<CoreConfig<2> >(); break;
+        case 4: selectCore<CoreConfig<4> >(); break;
+        case 5: selectCore<CoreConfig<5> >(); break;
+        case 6: selectCore<CoreConfig<6> >(); break;
+        case 8: selectCore<CoreConfig<8> >(); break;
+        default: return false;
+    }
+    core_width = width;
+    return true;
+}
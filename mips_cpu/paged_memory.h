@@ -0,0 +1,158 @@
+#ifndef PAGED_MEMORY
+#define PAGED_MEMORY
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include "checkpoint.h"
+
+#define MEM_PAGE_BITS 12
+#define MEM_PAGE_WORDS (1 << (MEM_PAGE_BITS - 2))
+#define MEM_TABLE_BITS 10
+#define MEM_TABLE_SIZE (1 << MEM_TABLE_BITS)
+#define MEM_DIR_SHIFT (MEM_PAGE_BITS + MEM_TABLE_BITS)
+#define MEM_DIR_SIZE (1 << (32 - MEM_DIR_SHIFT))
+
+// The full 32-bit guest address space, as 4 KB pages behind a two-level
+// table. Untouched pages all map to one shared page of zeroes, and
+// untouched 4 MB regions to one shared table of such pages, so reads never
+// allocate and need no checks. A page may also be borrowed read only from
+// elsewhere (the loader maps ELF segments straight from the file); either
+// kind is copied into a page of its own by the first write to it.
+// Accesses are by word: the low two address bits are ignored
+class PagedMemory {
+    public:
+        // pages[] is what loads read; writable[] holds the same page once
+        // this memory owns it, and null while it is shared
+        struct Table {
+            const uint32_t *pages[MEM_TABLE_SIZE];
+            uint32_t *writable[MEM_TABLE_SIZE];
+        };
+
+    private:
+        Table *dir[MEM_DIR_SIZE];
+        uint32_t allocated;         // owned pages
+
+        // Shared by every instance and never written
+        static const uint32_t *zeroPage() {
+            static const uint32_t page[MEM_PAGE_WORDS] = {};
+            return page;
+        }
+        static Table *zeroTable() {
+            static Table table = []() {
+                Table t;
+                for (int i = 0; i < MEM_TABLE_SIZE; i++) {
+                    t.pages[i] = zeroPage();
+                    t.writable[i] = nullptr;
+                }
+                return t;
+            }();
+            return &table;
+        }
+
+        Table *tableFor(uint32_t address) {
+            Table *&table = dir[address >> MEM_DIR_SHIFT];
+            if (table == zeroTable()) {
+                table = new Table(*zeroTable());
+            }
+            return table;
+        }
+        static uint32_t slot(uint32_t address) {
+            return (address >> MEM_PAGE_BITS) & (MEM_TABLE_SIZE - 1);
+        }
+
+    public:
+        PagedMemory() : allocated(0) {
+            for (Table *&table : dir) table = zeroTable();
+        }
+        ~PagedMemory() { clear(); }
+        PagedMemory(const PagedMemory &) = delete;
+        PagedMemory &operator=(const PagedMemory &) = delete;
+
+        uint32_t load(uint32_t address) const {
+            return pageOf(address)[(address >> 2) & (MEM_PAGE_WORDS - 1)];
+        }
+        // The page holding address, possibly shared; read only
+        const uint32_t *pageOf(uint32_t address) const {
+            return dir[address >> MEM_DIR_SHIFT]->pages[slot(address)];
+        }
+
+        // The page holding address, copied first if it was still shared
+        uint32_t *writablePage(uint32_t address) {
+            Table *table = tableFor(address);
+            uint32_t t = slot(address);
+            if (!table->writable[t]) {
+                uint32_t *page = new uint32_t[MEM_PAGE_WORDS];
+                memcpy(page, table->pages[t], MEM_PAGE_WORDS * 4);
+                table->pages[t] = table->writable[t] = page;
+                allocated++;
+            }
+            return table->writable[t];
+        }
+        void store(uint32_t address, uint32_t value) {
+            uint32_t *page = dir[address >> MEM_DIR_SHIFT]->writable[slot(address)];
+            if (!page) page = writablePage(address);
+            page[(address >> 2) & (MEM_PAGE_WORDS - 1)] = value;
+        }
+
+        // Makes the page at address read `page`, which has to stay valid
+        // and unchanged for as long as this memory refers to it. Whatever
+        // the page held before is dropped
+        void borrowPage(uint32_t address, const uint32_t *page) {
+            Table *table = tableFor(address);
+            uint32_t t = slot(address);
+            if (table->writable[t]) {
+                delete[] table->writable[t];
+                table->writable[t] = nullptr;
+                allocated--;
+            }
+            table->pages[t] = page;
+        }
+
+        uint32_t allocatedPages() const { return allocated; }
+
+        // For translated code, which walks the tables itself and leaves the
+        // runtime to copy a page when a store finds it shared
+        Table *const *directory() const { return dir; }
+
+        // Frees every page; all of memory reads as zero again
+        void clear() {
+            for (Table *&table : dir) {
+                if (table == zeroTable()) continue;
+                for (uint32_t *page : table->writable) {
+                    delete[] page;
+                }
+                delete table;
+                table = zeroTable();
+            }
+            allocated = 0;
+        }
+
+        // Every page that is not the zero page, borrowed ones included: their
+        // count, then each one's base address and words. Pages that were
+        // written back to all zeroes are kept
+        void save(CheckpointWriter &out) const {
+            uint32_t pages = 0;
+            for (const Table *table : dir) {
+                if (table == zeroTable()) continue;
+                for (const uint32_t *page : table->pages) pages += page != zeroPage();
+            }
+            out.put(pages);
+            for (uint32_t d = 0; d < MEM_DIR_SIZE; d++) {
+                if (dir[d] == zeroTable()) continue;
+                for (uint32_t t = 0; t < MEM_TABLE_SIZE; t++) {
+                    if (dir[d]->pages[t] == zeroPage()) continue;
+                    out.put<uint32_t>((d << MEM_DIR_SHIFT) | (t << MEM_PAGE_BITS));
+                    out.write(dir[d]->pages[t], MEM_PAGE_WORDS * 4);
+                }
+            }
+        }
+        void restore(CheckpointReader &in) {
+            clear();
+            uint32_t pages = in.get<uint32_t>();
+            for (uint32_t i = 0; i < pages && in.good(); i++) {
+                uint32_t address = in.get<uint32_t>();
+                in.read(writablePage(address), MEM_PAGE_WORDS * 4);
+            }
+        }
+};
+#endif
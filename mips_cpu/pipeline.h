@@ -0,0 +1,94 @@
+#ifndef PIPELINE
+#define PIPELINE
+#include <cstdint>
+
+// Latches between the stages of the five-stage pipeline (-O1)
+struct IF_ID_reg {
+    uint32_t instruction;
+    uint32_t pc;
+    
+};
+
+struct ID_EX_reg {
+    // Data read from registers
+    uint32_t read_data_1;
+    uint32_t read_data_2;
+    
+    // Instruction fields decoded in ID
+    int opcode;
+    int rs;
+    int rt;
+    int rd;
+    int shamt;
+    int funct;
+    uint32_t imm;
+    
+    // Control signals
+    bool ALU_src;
+    bool reg_dest;
+    unsigned ALU_op : 2;
+    int ALU_control;
+    bool shift;
+    bool mem_read;
+    bool mem_write;
+    bool halfword;
+    bool byte;
+    bool reg_write;
+    bool mem_to_reg;
+    int write_reg;
+    bool hilo;          // mult/div: the ALU's hi() goes to HI
+
+    // Branch/Jump control
+    bool branch;
+    bool bne;
+    bool jump;
+    bool jump_reg;
+    bool link;
+    uint32_t branch_target;
+    uint32_t jump_target;
+    uint32_t pc;
+};
+
+struct EX_MEM_reg {
+    uint32_t alu_result;
+    uint32_t hi_result;
+    bool hilo;
+    uint32_t write_data;
+    int write_reg;
+    
+    bool mem_read;
+    bool mem_write;
+    bool halfword;
+    bool byte;
+    bool reg_write;
+    bool mem_to_reg;
+    
+    // Branch results
+    bool branch_taken;
+    uint32_t branch_target;
+    bool jump;
+    uint32_t jump_target;
+    uint32_t pc;
+    bool link;
+};
+
+struct MEM_WB_reg {
+    uint32_t write_data;
+    uint32_t hi_data;
+    bool hilo;
+
+    int write_reg;
+    
+    bool reg_write;
+
+    uint32_t pc;
+};
+
+struct PipelineLatches {
+    IF_ID_reg if_id;
+    ID_EX_reg id_ex;
+    EX_MEM_reg ex_mem;
+    MEM_WB_reg mem_wb;
+    uint32_t current_pc;    // fetch PC
+};
+#endif
@@ -9,6 +9,8 @@ using namespace std;
 #endif
 
 #include <cstring> 
+#include <cstdlib>
+#include <algorithm>
 
 void Processor::initialize(int level) {
     // Initialize Control
@@ -27,18 +29,174 @@ void Processor::initialize(int level) {
                .byte = 0,
                .ALU_src = 0,
                .reg_write = 0,
-               .zero_extend = 0};
+               .zero_extend = 0,
+               .hilo = 0};
    
     opt_level = level;
 }
 
+static const char *const fu_class_names[FU_CLASSES] = {"alu", "branch", "agu", "muldiv"};
+
+// ALU control inputs by the operation names --fu-latency accepts
+static const struct { const char *name; int control; } alu_op_names[] = {
+    {"and", 0}, {"or", 1}, {"add", 2}, {"sll", 3}, {"srl", 4}, {"lui", 5}, {"sub", 6}, {"slt", 7},
+    {"mult", 8}, {"multu", 9}, {"div", 10}, {"divu", 11}, {"nor", 12}
+};
+
+FunctionalUnits::FunctionalUnits() : result_buses(0) {
+    for (int c = 0; c < FU_CLASSES; c++) {
+        class_latency[c] = 1;
+        unpipelined[c] = false;
+    }
+    for (int op = 0; op < ALU_CONTROLS; op++) {
+        op_latency[op] = 0;
+        unpipelined_op[op] = false;
+    }
+    // Multiplies are pipelined; a divide iterates, a quotient bit a cycle
+    class_latency[FU_MULDIV] = 4;
+    op_latency[10] = op_latency[11] = 32;
+    unpipelined_op[10] = unpipelined_op[11] = true;
+}
+
+// Splits list at sep; false if any item is empty
+static bool split(const std::string &list, char sep, std::vector<std::string> &items) {
+    items.clear();
+    size_t begin = 0;
+    while (begin <= list.size()) {
+        size_t end = list.find(sep, begin);
+        if (end == std::string::npos) end = list.size();
+        if (end == begin) return false;
+        items.push_back(list.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    return true;
+}
+
+static int fuClassByName(const std::string &name) {
+    for (int c = 0; c < FU_CLASSES; c++) {
+        if (name == fu_class_names[c]) return c;
+    }
+    return -1;
+}
+
+static int aluOpByName(const std::string &name) {
+    for (const auto &op : alu_op_names) {
+        if (name == op.name) return op.control;
+    }
+    return -1;
+}
+
+bool FunctionalUnits::setPorts(const std::string &list) {
+    std::vector<std::string> items, names;
+    if (!split(list, ',', items)) return false;
+    std::vector<unsigned> parsed;
+    unsigned covered = 0;
+    for (const std::string &item : items) {
+        if (!split(item, '+', names)) return false;
+        unsigned classes = 0;
+        for (const std::string &name : names) {
+            int c = fuClassByName(name);
+            if (c < 0 && name != "any") return false;
+            classes |= c < 0 ? FU_ALL : 1u << c;
+        }
+        parsed.push_back(classes);
+        covered |= classes;
+    }
+    // An instruction no port takes would never issue
+    if (covered != FU_ALL) return false;
+    ports = parsed;
+    return true;
+}
+
+bool FunctionalUnits::setLatencies(const std::string &list) {
+    std::vector<std::string> items;
+    if (!split(list, ',', items)) return false;
+    for (const std::string &item : items) {
+        size_t colon = item.find(':');
+        if (colon == std::string::npos) return false;
+        std::string name = item.substr(0, colon);
+        char *end;
+        long cycles = strtol(item.c_str() + colon + 1, &end, 10);
+        if (*end || end == item.c_str() + colon + 1 || cycles < 1 || cycles > 1000) return false;
+        int c = fuClassByName(name);
+        int op = aluOpByName(name);
+        if (c >= 0) {
+            class_latency[c] = cycles;
+        } else if (op >= 0) {
+            op_latency[op] = cycles;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FunctionalUnits::setUnpipelined(const std::string &list) {
+    std::vector<std::string> names;
+    bool classes[FU_CLASSES] = {};
+    bool ops[ALU_CONTROLS] = {};
+    if (list != "none") {
+        if (!split(list, ',', names)) return false;
+        for (const std::string &name : names) {
+            int c = fuClassByName(name);
+            int op = aluOpByName(name);
+            if (c >= 0) classes[c] = true;
+            else if (op >= 0) ops[op] = true;
+            else return false;
+        }
+    }
+    std::copy(classes, classes + FU_CLASSES, unpipelined);
+    std::copy(ops, ops + ALU_CONTROLS, unpipelined_op);
+    return true;
+}
+
+static const char *const issue_policy_names[] = {"oldest", "index", "branch-first", "load-first"};
+
+bool Processor::issuePolicyByName(const std::string &name, IssuePolicy &policy) {
+    for (int i = 0; i < 4; i++) {
+        if (name == issue_policy_names[i]) {
+            policy = (IssuePolicy)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *Processor::issuePolicyName(IssuePolicy policy) {
+    return issue_policy_names[policy];
+}
+
+void Processor::reset() {
+    regfile = Registers();
+    regfile.pc = 0;
+    pipeline = PipelineLatches();
+    branch_predictor.reset();
+    setWidth(core_width);
+    functional.invalidate();
+    warming = false;
+    restart_core = false;
+    fetch_enabled = true;
+    core_committed = 0;
+    core_drained = true;
+    core_fetch_pc = 0;
+}
+
+void Processor::start(uint32_t entry, uint32_t stack_pointer) {
+    uint32_t unused;
+    regfile.access(0, 0, unused, unused, 29, true, stack_pointer);
+    regfile.pc = entry;
+    pipeline.current_pc = entry;
+    // The out-of-order core picks both up as it restarts
+    restart_core = true;
+}
+
 void Processor::advance() {
     switch (opt_level) {
         case 0: single_cycle_processor_advance();
                 break;
         case 1: pipelined_processor_advance();
                 break;
-        default: optimized_processor_advance();
+        default: (this->*optimized_advance)();
                 break;
     }
 }
@@ -51,23 +209,23 @@ void Processor::single_cycle_processor_advance() {
     memory->access(regfile.pc, instruction, 0, 1, 0);
 
     // increment pc
-    std::cout << "PC: 0x" << std::hex << regfile.pc << std::dec << std::endl;
+    if (trace) {
+        *trace << "PC: 0x";
+        trace->putHex(regfile.pc);
+        *trace << "\n";
+    }
+    uint32_t pc = regfile.pc;
     regfile.pc += 4;
     
-    // decode into contol signals
-    control.decode(instruction);
+    // decoded once per text word, see DecodeCache
+    const DecodedInst &decoded = memory->predecode.lookup(pc, instruction);
+    const control_t &control = decoded.control;
     DEBUG(control.print());
 
-
-    // extract rs, rt, rd, imm, funct 
-    int opcode = (instruction >> 26) & 0x3f;
-    int rs = (instruction >> 21) & 0x1f;
-    int rt = (instruction >> 16) & 0x1f;
-    int rd = (instruction >> 11) & 0x1f;
-    int shamt = (instruction >> 6) & 0x1f;
-    int funct = instruction & 0x3f;
-    uint32_t imm = (instruction & 0xffff);
-    int addr = instruction & 0x3ffffff;
+    int rs = decoded.rs;
+    int rt = decoded.rt;
+    int shamt = decoded.shamt;
+    uint32_t imm = decoded.imm;
     // Variables to read data into
     uint32_t read_data_1 = 0;
     uint32_t read_data_2 = 0;
@@ -78,10 +236,7 @@ void Processor::single_cycle_processor_advance() {
     // std::cout << "RS: " << rs << ", RT: " << rt << std::endl;
     // std::cout << "Immediate: 0x" << std::hex << imm << std::dec << std::endl;
     // Execution 
-    alu.generate_control_inputs(control.ALU_op, funct, opcode);
-    // Sign Extend Or Zero Extend the immediate
-    // Using Arithmetic right shift in order to replicate 1 
-    imm = control.zero_extend ? imm : (imm >> 15) ? 0xffff0000 | imm : imm;
+    alu.set_control_inputs(decoded.ALU_control);
     
     // Find operands for the ALU Execution
     // Operand 1 is always R[rs] -> read_data_1, except sll and srl
@@ -106,16 +261,36 @@ void Processor::single_cycle_processor_advance() {
     // Loads: lbu or lhu modify read data by masking
     read_data_mem &= control.halfword ? 0xffff : control.byte ? 0xff : 0xffffffff;
 
-    int write_reg = control.link ? 31 : control.reg_dest ? rd : rt;
-
-    uint32_t write_data = control.link ? regfile.pc+8 : control.mem_to_reg ? read_data_mem : alu_result;  
+    uint32_t write_data = control.link ? pc+8 : control.mem_to_reg ? read_data_mem : alu_result;  
 
     // Write Back
-    regfile.access(0, 0, read_data_2, read_data_2, write_reg, control.reg_write, write_data);
+    regfile.access(0, 0, read_data_2, read_data_2, decoded.write_reg, control.reg_write, write_data);
+    regfile.access(0, 0, read_data_2, read_data_2, REG_HI, control.hilo, alu.hi());
     
     // Update PC
-    regfile.pc += (control.branch && !control.bne && alu_zero) || (control.bne && !alu_zero) ? imm << 2 : 0; 
-    regfile.pc = control.jump_reg ? read_data_1 : control.jump ? (regfile.pc & 0xf0000000) & (addr << 2): regfile.pc;
+    regfile.pc = (control.branch && !control.bne && alu_zero) || (control.bne && !alu_zero) ? decoded.branch_target : regfile.pc; 
+    regfile.pc = control.jump_reg ? read_data_1 : control.jump ? decoded.jump_target : regfile.pc;
+
+    if (warming) {
+        // Train the predictor the way the out-of-order core does when this
+        // instruction commits (the recorded target depends on the prediction)
+        BranchKind kind = branchKind(decoded);
+        std::pair<bool, uint32_t> prediction = branch_predictor.predict(pc, kind);
+        bool predicted_taken = prediction.first;
+        bool taken = control.jump || (!control.bne && control.branch && alu_zero) || (control.bne && !alu_zero);
+        if (control.branch) {
+            branch_predictor.update(pc, kind, taken, predicted_taken ? pc + 4 : decoded.branch_target, taken != predicted_taken);
+        } else if (control.jump_reg) {
+            branch_predictor.update(pc, kind, true, read_data_1, !predicted_taken || prediction.second != read_data_1);
+        } else if (control.jump) {
+            branch_predictor.update(pc, kind, true, pc + 4, !predicted_taken);
+        } else {
+            branch_predictor.update(pc, kind, false, 0, predicted_taken);
+        }
+        if (taken != predicted_taken) {
+            branch_predictor.flush();
+        }
+    }
 }
 
 
@@ -126,88 +301,12 @@ void Processor::single_cycle_processor_advance() {
 
 
 
-struct IF_ID_reg {
-    uint32_t instruction;
-    uint32_t pc;
-    
-};
-
-struct ID_EX_reg {
-    // Data read from registers
-    uint32_t read_data_1;
-    uint32_t read_data_2;
-    
-    // Instruction fields decoded in ID
-    int opcode;
-    int rs;
-    int rt;
-    int rd;
-    int shamt;
-    int funct;
-    uint32_t imm;
-    
-    // Control signals
-    bool ALU_src;
-    bool reg_dest;
-    unsigned ALU_op : 2;
-    bool shift;
-    bool mem_read;
-    bool mem_write;
-    bool halfword;
-    bool byte;
-    bool reg_write;
-    bool mem_to_reg;
-
-    // Branch/Jump control
-    bool branch;
-    bool bne;
-    bool jump;
-    bool jump_reg;
-    bool link;
-    uint32_t branch_target;
-    uint32_t jump_target;
-    uint32_t pc;
-};
-
-struct EX_MEM_reg {
-    uint32_t alu_result;
-    uint32_t write_data;
-    int write_reg;
-    
-    bool mem_read;
-    bool mem_write;
-    bool halfword;
-    bool byte;
-    bool reg_write;
-    bool mem_to_reg;
-    
-    // Branch results
-    bool branch_taken;
-    uint32_t branch_target;
-    bool jump;
-    uint32_t jump_target;
-    uint32_t pc;
-    bool link;
-};
-
-struct MEM_WB_reg {
-    uint32_t write_data;
-
-    int write_reg;
-    
-    bool reg_write;
-
-    uint32_t pc;
-};
-
-
-
 void Processor::pipelined_processor_advance() {
-    static IF_ID_reg if_id;
-    static ID_EX_reg id_ex;
-    static EX_MEM_reg ex_mem;
-    static MEM_WB_reg mem_wb;
-    static uint32_t current_pc = 0;
+    IF_ID_reg &if_id = pipeline.if_id;
+    ID_EX_reg &id_ex = pipeline.id_ex;
+    EX_MEM_reg &ex_mem = pipeline.ex_mem;
+    MEM_WB_reg &mem_wb = pipeline.mem_wb;
+    uint32_t &current_pc = pipeline.current_pc;
 
     
     bool flush = false;
@@ -219,6 +318,10 @@ void Processor::pipelined_processor_advance() {
         
         regfile.access(0, 0, read_data_1, read_data_2, mem_wb.write_reg, true, mem_wb.write_data);
     }
+    if (mem_wb.hilo) {
+        uint32_t read_data_1, read_data_2;
+        regfile.access(0, 0, read_data_1, read_data_2, REG_HI, true, mem_wb.hi_data);
+    }
     regfile.pc = mem_wb.pc;  // Update regfile PC to match WB stage PC
 
 
@@ -232,6 +335,9 @@ void Processor::pipelined_processor_advance() {
             id_ex.read_data_2 = mem_wb.write_data;
         }
     }
+    if (mem_wb.hilo && id_ex.rs == REG_HI) {
+        id_ex.read_data_1 = mem_wb.hi_data;
+    }
 
     uint32_t read_data_mem = 0;
     uint32_t write_data_mem = 0;
@@ -269,6 +375,8 @@ void Processor::pipelined_processor_advance() {
     mem_wb.write_data = write_data;
     mem_wb.write_reg = ex_mem.write_reg;
     mem_wb.reg_write = ex_mem.reg_write;
+    mem_wb.hi_data = ex_mem.hi_result;
+    mem_wb.hilo = ex_mem.hilo;
     mem_wb.pc = ex_mem.pc;  
 
     // EX Stage
@@ -281,12 +389,15 @@ void Processor::pipelined_processor_advance() {
             id_ex.read_data_2 = ex_mem.alu_result;
         }
     }
+    if (ex_mem.hilo && id_ex.rs == REG_HI) {
+        id_ex.read_data_1 = ex_mem.hi_result;
+    }
 
     uint32_t alu_zero;
     uint32_t operand_1 = id_ex.shift ? id_ex.shamt : id_ex.read_data_1;
     uint32_t operand_2 = id_ex.ALU_src ? id_ex.imm : id_ex.read_data_2;
     
-    alu.generate_control_inputs(id_ex.ALU_op, id_ex.funct, id_ex.opcode);
+    alu.set_control_inputs(id_ex.ALU_control);
     uint32_t ex_result = alu.execute(operand_1, operand_2, alu_zero);
     
     // Branch/Jump decision in EX stage
@@ -306,8 +417,10 @@ void Processor::pipelined_processor_advance() {
 
     // EX/MEM ← ID/EX
     ex_mem.alu_result = ex_result;
+    ex_mem.hi_result = alu.hi();
+    ex_mem.hilo = id_ex.hilo;
     ex_mem.write_data = id_ex.read_data_2;
-    ex_mem.write_reg = id_ex.link? 31: id_ex.reg_dest ? id_ex.rd : id_ex.rt;
+    ex_mem.write_reg = id_ex.write_reg;
     ex_mem.mem_read = id_ex.mem_read;
     ex_mem.mem_write = id_ex.mem_write;
     ex_mem.reg_write = id_ex.reg_write;
@@ -325,24 +438,22 @@ void Processor::pipelined_processor_advance() {
         // ID Stage
 
         // ID/EX ← IF/ID
-        control_t control;
-        control.decode(if_id.instruction);
+        const DecodedInst &decoded = memory->predecode.lookup(if_id.pc, if_id.instruction);
+        const control_t &control = decoded.control;
         
-        id_ex.opcode = (if_id.instruction >> 26) & 0x3f;
-        id_ex.rs = (if_id.instruction >> 21) & 0x1f;
-        id_ex.rt = (if_id.instruction >> 16) & 0x1f;
-        id_ex.rd = (if_id.instruction >> 11) & 0x1f;
-        id_ex.shamt = (if_id.instruction >> 6) & 0x1f;
-        id_ex.funct = if_id.instruction & 0x3f;
-        id_ex.imm = (if_id.instruction & 0xffff);
+        id_ex.opcode = decoded.opcode;
+        id_ex.rs = decoded.rs;
+        id_ex.rt = decoded.rt;
+        id_ex.rd = decoded.rd;
+        id_ex.shamt = decoded.shamt;
+        id_ex.funct = decoded.funct;
+        id_ex.imm = decoded.imm;
         id_ex.pc = if_id.pc; 
+        id_ex.ALU_control = decoded.ALU_control;
         
-        id_ex.imm = control.zero_extend ? id_ex.imm : (id_ex.imm >> 15) ? 0xffff0000 | id_ex.imm : id_ex.imm;
-        
-        // Calculate jump and branch targets in decode stage
-        uint32_t jump_addr = if_id.instruction & 0x03FFFFFF;  
-        id_ex.jump_target = (if_id.pc & 0xF0000000) | (jump_addr << 2);  
-        id_ex.branch_target = if_id.pc + 4 + (id_ex.imm << 2); 
+        // Jump and branch targets were computed at predecode
+        id_ex.jump_target = decoded.jump_target;
+        id_ex.branch_target = decoded.branch_target;
 
         
         // Access register file
@@ -357,6 +468,8 @@ void Processor::pipelined_processor_advance() {
         id_ex.mem_write = control.mem_write;
         id_ex.reg_write = control.reg_write;
         id_ex.mem_to_reg = control.mem_to_reg;
+        id_ex.write_reg = decoded.write_reg;
+        id_ex.hilo = control.hilo;
         id_ex.halfword = control.halfword;
         id_ex.byte = control.byte;
         
@@ -2,6 +2,68 @@
 #include "regfile.h"
 #include "ALU.h"
 #include "control.h"
+#include "functional.h"
+#include "branch_predictor.h"
+#include "pipeline.h"
+#include <memory>
+
+// State of the out-of-order core; the concrete type depends on the width
+// it was built for (see OptimizedCore in optimized.cpp)
+struct OutOfOrderCore {
+    virtual ~OutOfOrderCore() {}
+};
+
+// How the out-of-order core picks among the scheduling queue entries that
+// are ready to execute (--issue)
+enum IssuePolicy {
+    ISSUE_OLDEST,           // oldest in program order first
+    ISSUE_INDEX,            // lowest queue slot first, the core's original order
+    ISSUE_BRANCH_FIRST,     // oldest branch or jr, else the oldest
+    ISSUE_LOAD_FIRST        // oldest load, else the oldest
+};
+
+// Functional unit classes of the -O2+ core. Loads and stores use an AGU for
+// their address; branches and jr a branch unit
+enum FUClass { FU_ALU, FU_BRANCH, FU_AGU, FU_MULDIV, FU_CLASSES };
+#define FU_ALL ((1u << FU_CLASSES) - 1)
+#define ALU_CONTROLS 16
+
+// Issue ports and execution latencies of the -O2+ core (--ports,
+// --fu-latency, --unpipelined, --result-buses). Each port starts at most one
+// instruction a cycle, of the classes it serves. A result with latency L is
+// broadcast L-1 cycles after issue, so with the default of 1 dependents can
+// still issue in the same cycle. The defaults are the original core: one port
+// per unit of width serving everything, single-cycle units, no bus limit;
+// only mult/div take longer, a pipelined 4-cycle multiply and an iterative
+// 32-cycle divide
+struct FunctionalUnits {
+    std::vector<unsigned> ports;    // FU_* bitmask per port; empty for the default
+    int class_latency[FU_CLASSES];
+    int op_latency[ALU_CONTROLS];   // by ALU control input; 0 to use the class's
+    bool unpipelined[FU_CLASSES];   // an unpipelined port is busy until its result is out
+    bool unpipelined_op[ALU_CONTROLS];  // the same for single ALU ops
+    int result_buses;               // results broadcast per cycle; 0 for no limit
+
+    FunctionalUnits();
+
+    int latency(int fu_class, int ALU_control) const {
+        return op_latency[ALU_control] ? op_latency[ALU_control] : class_latency[fu_class];
+    }
+
+    bool pipelined(int fu_class, int ALU_control) const {
+        return !unpipelined[fu_class] && !unpipelined_op[ALU_control];
+    }
+
+    // Parsers for the options above; each returns false on a bad list.
+    // Ports are '+'-joined class names (alu, branch, agu, muldiv or any),
+    // latencies "<class or ALU op>:<cycles>" pairs, unpipelined classes or ops
+    bool setPorts(const std::string &list);
+    bool setLatencies(const std::string &list);
+    bool setUnpipelined(const std::string &list);
+};
+
+// All simulation state lives in the object (memory is owned by the caller),
+// so independent Processor/Memory pairs can run on different threads.
 class Processor {
     private:
         int opt_level;
@@ -9,27 +71,150 @@ class Processor {
         control_t control;
         Memory *memory;
         Registers regfile;
+        BufferedWriter *trace;
+        FunctionalSimulator functional;
+        BranchPredictor branch_predictor;   // used by the out-of-order core
+
+        // Sampled simulation (see sampling.cpp)
+        bool warming;               // single-cycle core also trains branch_predictor
+        bool restart_core;          // out-of-order core restarts at regfile.pc next cycle
+        bool fetch_enabled;         // cleared to drain the out-of-order core
+        uint64_t core_committed;    // instructions the out-of-order core has committed
+        bool core_drained;          // nothing in flight and no memory requests pending
+        uint32_t core_fetch_pc;     // next PC the out-of-order core would fetch
         // add other structures as needed
 
         // pipelined processor
+        PipelineLatches pipeline;
 
         // add private functions
         void single_cycle_processor_advance();
         void pipelined_processor_advance();
-        void optimized_processor_advance();
+        template <class Config> void optimized_processor_advance();
+        template <class Config> uint64_t optimized_skip_idle(uint64_t max_cycles);
+        template <class Config> void selectCore();
+
+        // out-of-order core specialized for the selected superscalar width
+        void (Processor::*optimized_advance)();
+        uint64_t (Processor::*optimized_skip)(uint64_t max_cycles);
+        std::unique_ptr<OutOfOrderCore> ooo_core;
+        int core_width;
+        IssuePolicy issue_policy;
+        FunctionalUnits units;
  
     public:
-        Processor(Memory *mem) { regfile.pc = 0; memory = mem;}
+        Processor(Memory *mem) : functional(mem) {
+            memory = mem; trace = nullptr; opt_level = 0; core_width = 1; issue_policy = ISSUE_OLDEST; reset();
+        }
+
+        // Back to the power-on state: registers, pipeline latches, the
+        // out-of-order core and branch predictor. Memory is left alone; load
+        // a program into it (or restore a checkpoint) before running again
+        void reset();
+
+        // Starts the loaded program at entry, with $sp (R29) set to
+        // stack_pointer. Call after reset() and before the first advance()
+        void start(uint32_t entry, uint32_t stack_pointer);
 
         // Get PC
         uint32_t getPC() { return regfile.pc; }
 
         // Prints the Register File
         void printRegFile() { regfile.print(); }
+        void printRegFile(BufferedWriter &out) { regfile.print(out); }
+
+        // Prints the registers that changed since the values recorded in last[]
+        void printRegFileChanges(BufferedWriter &out, uint64_t cycle, int32_t *last) { regfile.printChanged(out, cycle, last); }
+
+        // Per-instruction trace output (the single-cycle core prints its PC); nullptr disables it
+        void setTrace(BufferedWriter *out) { trace = out; }
         
         // Initializes the processor appropriately based on the optimization level
         void initialize(int opt_level);
 
+        // Selects the superscalar width of the out-of-order core (-O2 and above)
+        // Returns false if no core was built for this width
+        bool setWidth(int width);
+
+        // Issue selection of the -O2+ core; kept across reset()
+        void setIssuePolicy(IssuePolicy policy) { issue_policy = policy; }
+
+        // Functional units of the -O2+ core; kept across reset()
+        void setFunctionalUnits(const FunctionalUnits &fu) { units = fu; }
+
+        // Direction predictor of the -O2+ core, by --bpred spec (see
+        // makeDirectionPredictor), its return address stack depth, indirect
+        // target cache size and loop predictor size; kept across reset().
+        // False for a bad configuration
+        bool setBranchPredictor(const std::string &spec,
+                                size_t ras_depth = BranchPredictor::DEFAULT_RAS_DEPTH,
+                                size_t indirect_entries = BranchPredictor::DEFAULT_INDIRECT_ENTRIES,
+                                size_t loop_entries = BranchPredictor::DEFAULT_LOOP_ENTRIES) {
+            if (!BranchPredictor::valid(spec) || ras_depth > BranchPredictor::MAX_RAS_DEPTH ||
+                !BranchPredictor::validIndirectEntries(indirect_entries) ||
+                !LoopPredictor::validSize(loop_entries)) return false;
+            branch_predictor = BranchPredictor(spec, ras_depth, indirect_entries, loop_entries);
+            return true;
+        }
+
+        // Conditional branch, loop, return and indirect jump prediction accuracy so far
+        void printBranchStats(std::ostream &out) const { branch_predictor.printStats(out); }
+
+        // Policy names accepted by --issue: oldest, index, branch-first and
+        // load-first. Returns false for anything else
+        static bool issuePolicyByName(const std::string &name, IssuePolicy &policy);
+        static const char *issuePolicyName(IssuePolicy policy);
+
         // Advances the processor to an appropriate state every cycle
         void advance(); 
+
+        // Call between advance()s. If the -O2+ core cannot do anything until a
+        // memory request completes, jumps over those cycles (at most max_cycles)
+        // and returns how many; the result is exactly as if advance() had been
+        // called that many times. Returns 0 otherwise
+        uint64_t skipIdleCycles(uint64_t max_cycles) {
+            return opt_level >= 2 ? (this->*optimized_skip)(max_cycles) : 0;
+        }
+
+        // Runs the functional engine on translated x86-64 code from now on.
+        // Returns false if this host has no native backend
+        bool enableJit() { return functional.enableJit(); }
+
+        // Runs the untimed functional engine from the current PC until the PC passes
+        // end_pc or max_insts instructions retire. Returns the instructions retired
+        uint64_t runFunctional(uint32_t end_pc, uint64_t max_insts = UINT64_MAX) {
+            return functional.run(regfile, end_pc, max_insts);
+        }
+
+        // Sampled simulation: fastForward runs up to max_insts instructions on
+        // the single-cycle core while warming the caches and branch predictor;
+        // runDetailed then runs the out-of-order core from the same state for
+        // warmup + measure committed instructions and drains it.
+        struct DetailedWindow {
+            uint64_t cycles;        // cycles spent on the measured instructions
+            uint64_t measured;      // instructions committed while measuring
+            uint64_t committed;     // all instructions committed, drain included
+            bool finished;          // the program ended inside the window
+        };
+        uint64_t fastForward(uint32_t end_pc, uint64_t max_insts);
+        DetailedWindow runDetailed(uint32_t end_pc, uint64_t warmup, uint64_t measure);
+
+        // The single-cycle core also trains the caches and branch predictor,
+        // so state saved from an -O0 run is useful to a detailed restore
+        void setWarming(bool on) { warming = on; memory->setWarming(on); }
+
+        // Instructions committed by the out-of-order core so far
+        uint64_t committedInstructions() { return core_committed; }
+
+        // Checkpoints hold architectural and microarchitectural state but
+        // nothing in flight: beginDrain stops fetch, advance() until drained(),
+        // then endDrain leaves regfile.pc at the next instruction to run
+        void beginDrain() { fetch_enabled = false; }
+        bool drained() { return opt_level < 2 || core_drained; }
+        void endDrain();
+
+        // Registers, branch predictor, memory and caches (see checkpoint.h).
+        // restore() returns false on a truncated or mismatched checkpoint
+        void save(CheckpointWriter &out);
+        bool restore(CheckpointReader &in);
 };
@@ -3,6 +3,14 @@
 #include <vector>
 #include <cstdint>
 #include <iostream>
+#include "writer.h"
+#include "checkpoint.h"
+
+// HI and LO, written by mult/div and read by mfhi/mflo, sit after the 32
+// general registers so every core can rename and forward them like the rest
+#define REG_HI 32
+#define REG_LO 33
+#define NUM_REGS 34
 
 struct PhysReg {
     int32_t value;
@@ -18,8 +26,8 @@ class Registers {
     public:
         uint32_t pc;
         Registers() {
-            R.resize(32);
-            for (int i = 0; i < 32; i++) {
+            R.resize(NUM_REGS);
+            for (int i = 0; i < NUM_REGS; i++) {
                 R[i].value = 0;
                 R[i].ready = true;
             }
@@ -43,12 +51,40 @@ class Registers {
             return R[reg].ready;
         }
 
-        // Prints the contents of all the registers
+        void save(CheckpointWriter &out) const {
+            out.section("REGS");
+            out.putVector(R);
+            out.put(pc);
+        }
+
+        void restore(CheckpointReader &in) {
+            in.section("REGS");
+            in.getVector(R);
+            pc = in.get<uint32_t>();
+        }
+
+        // Prints the contents of all the general registers
         void print() {
             for(int i = 0; i < 32; ++i) {
                 std::cout << std::dec << "R[" << i << "]: " << R[i].value << "\n";
             }
         }
+        // Same as print(), into a buffered writer
+        void print(BufferedWriter &out) {
+            for(int i = 0; i < 32; ++i) {
+                out << "R[" << i << "]: " << R[i].value << "\n";
+            }
+        }
+        // Prints only the registers whose value differs from last[], tagged with
+        // the cycle number, and records the new values in last[]
+        void printChanged(BufferedWriter &out, uint64_t cycle, int32_t *last) {
+            for(int i = 0; i < 32; ++i) {
+                if (R[i].value != last[i]) {
+                    out << "CYCLE " << cycle << " R[" << i << "]: " << R[i].value << "\n";
+                    last[i] = R[i].value;
+                }
+            }
+        }
         // Prints the contents of the register specified by reg 
         // This function should help you debug your code
         void print(int reg) {
@@ -0,0 +1,292 @@
+#ifndef REPLACEMENT
+#define REPLACEMENT
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <algorithm>
+#include "checkpoint.h"
+
+// Tag value of an invalid way; real tags are at most 26 bits wide
+#define INVALID_TAG 0xffffffffu
+
+// Replacement state of one cache. The cache calls touch() when a lookup
+// finds the line, victim() to choose the way for a new line and insert()
+// once it is there. `tags` always points at the set's assoc tags.
+class ReplacementPolicy {
+    protected:
+        int sets;
+        int assoc;
+        uint64_t rng;
+
+        // xorshift64, so runs are reproducible for a given seed
+        uint32_t random() {
+            rng ^= rng << 13;
+            rng ^= rng >> 7;
+            rng ^= rng << 17;
+            return (uint32_t)(rng >> 32);
+        }
+        static int firstInvalid(const uint32_t *tags, int assoc) {
+            for (int w = 0; w < assoc; w++) {
+                if (tags[w] == INVALID_TAG) return w;
+            }
+            return -1;
+        }
+
+    public:
+        ReplacementPolicy(int sets, int assoc, uint64_t seed) : sets(sets), assoc(assoc), rng(seed | 1) {}
+        virtual ~ReplacementPolicy() {}
+
+        virtual const char *name() const = 0;
+
+        // A demand access hit the line in way
+        virtual void touch(int set, int way, const uint32_t *tags) = 0;
+
+        // A fill found the line already present. Not a new reference; LRU
+        // has always promoted here, the other policies leave the line be
+        virtual void refill(int set, int way, const uint32_t *tags) {}
+
+        // Way to fill, or -1 if the fill has to be retried
+        virtual int victim(int set, const uint32_t *tags) = 0;
+
+        // A new line was placed in way
+        virtual void insert(int set, int way, const uint32_t *tags) = 0;
+
+        // Every way was invalidated
+        virtual void clear() = 0;
+
+        virtual void save(CheckpointWriter &out) const { out.put(rng); }
+        virtual void restore(CheckpointReader &in) { rng = in.get<uint64_t>(); }
+};
+
+// The simulator's original LRU: a counter per way, assoc-1 for the most
+// recent line. Choosing a victim ages every way it passes over, so a fill
+// into a set with no zero counter installs nothing and is retried
+class LRUPolicy : public ReplacementPolicy {
+    private:
+        std::vector<uint8_t> bits;
+
+    public:
+        LRUPolicy(int sets, int assoc, uint64_t seed) : ReplacementPolicy(sets, assoc, seed), bits(sets * assoc, 0) {}
+        const char *name() const { return "lru"; }
+
+        void touch(int set, int way, const uint32_t *tags) {
+            uint8_t *setBits = &bits[set * assoc];
+            uint8_t current = setBits[way];
+            for (int w = 0; w < assoc; w++) {
+                if (tags[w] != INVALID_TAG && setBits[w] > current) {
+                    setBits[w]--;
+                }
+            }
+            setBits[way] = assoc - 1;
+        }
+        void refill(int set, int way, const uint32_t *tags) { touch(set, way, tags); }
+
+        int victim(int set, const uint32_t *tags) {
+            uint8_t *setBits = &bits[set * assoc];
+            for (int w = 0; w < assoc; w++) {
+                if (tags[w] == INVALID_TAG || setBits[w] == 0) {
+                    return w;
+                }
+                setBits[w]--;
+            }
+            return -1;
+        }
+        void insert(int set, int way, const uint32_t *tags) { bits[set * assoc + way] = assoc - 1; }
+        void clear() { std::fill(bits.begin(), bits.end(), 0); }
+
+        void save(CheckpointWriter &out) const { out.putVector(bits); }
+        void restore(CheckpointReader &in) { in.getVector(bits); }
+};
+
+// Tree pseudo-LRU: assoc-1 bits per set, each pointing at the half that
+// holds the next victim. Needs a power-of-two associativity
+class TreePLRUPolicy : public ReplacementPolicy {
+    private:
+        std::vector<uint64_t> trees;
+        int levels;
+
+    public:
+        TreePLRUPolicy(int sets, int assoc, uint64_t seed) : ReplacementPolicy(sets, assoc, seed), trees(sets, 0) {
+            levels = 0;
+            while ((1 << levels) < assoc) levels++;
+        }
+        const char *name() const { return "plru"; }
+
+        // Nodes are numbered heap style from 1; a set bit points right
+        void touch(int set, int way, const uint32_t *tags) {
+            uint64_t &tree = trees[set];
+            int node = 1;
+            for (int level = levels - 1; level >= 0; level--) {
+                int right = (way >> level) & 1;
+                tree = right ? tree & ~(1ull << node) : tree | (1ull << node);
+                node = node * 2 + right;
+            }
+        }
+        void refill(int set, int way, const uint32_t *tags) { touch(set, way, tags); }
+
+        int victim(int set, const uint32_t *tags) {
+            int way = firstInvalid(tags, assoc);
+            if (way >= 0) {
+                return way;
+            }
+            int node = 1;
+            way = 0;
+            for (int level = 0; level < levels; level++) {
+                int right = (trees[set] >> node) & 1;
+                way = way * 2 + right;
+                node = node * 2 + right;
+            }
+            return way;
+        }
+        void insert(int set, int way, const uint32_t *tags) { touch(set, way, tags); }
+        void clear() { std::fill(trees.begin(), trees.end(), 0); }
+
+        void save(CheckpointWriter &out) const { out.putVector(trees); }
+        void restore(CheckpointReader &in) { in.getVector(trees); }
+};
+
+// Re-reference interval prediction with 2-bit RRPVs (Jaleel et al., ISCA
+// 2010). Hits predict a near re-reference; SRRIP inserts with a long
+// interval, BRRIP mostly with a distant one so scans do not flush the set
+class RRIPPolicy : public ReplacementPolicy {
+    protected:
+        enum { MAX_RRPV = 3 };
+        std::vector<uint8_t> rrpv;
+        bool bimodal;
+
+        uint8_t insertionRRPV(bool brrip) {
+            // BRRIP uses the long interval only once in 32 fills
+            return brrip && (random() & 31) ? MAX_RRPV : MAX_RRPV - 1;
+        }
+
+    public:
+        RRIPPolicy(int sets, int assoc, uint64_t seed, bool bimodal)
+            : ReplacementPolicy(sets, assoc, seed), rrpv(sets * assoc, MAX_RRPV), bimodal(bimodal) {}
+        const char *name() const { return bimodal ? "brrip" : "srrip"; }
+
+        void touch(int set, int way, const uint32_t *tags) { rrpv[set * assoc + way] = 0; }
+
+        int victim(int set, const uint32_t *tags) {
+            int way = firstInvalid(tags, assoc);
+            if (way >= 0) {
+                return way;
+            }
+            // Age the whole set until some line reaches the maximum
+            uint8_t *setRRPV = &rrpv[set * assoc];
+            int oldest = *std::max_element(setRRPV, setRRPV + assoc);
+            for (int w = 0; w < assoc; w++) {
+                setRRPV[w] += MAX_RRPV - oldest;
+            }
+            for (way = 0; setRRPV[way] != MAX_RRPV; way++);
+            return way;
+        }
+        void insert(int set, int way, const uint32_t *tags) {
+            rrpv[set * assoc + way] = insertionRRPV(bimodal);
+        }
+        void clear() { std::fill(rrpv.begin(), rrpv.end(), MAX_RRPV); }
+
+        void save(CheckpointWriter &out) const { ReplacementPolicy::save(out); out.putVector(rrpv); }
+        void restore(CheckpointReader &in) { ReplacementPolicy::restore(in); in.getVector(rrpv); }
+};
+
+// Dynamic insertion (Qureshi et al., ISCA 2007): true LRU stacks, with set
+// dueling between MRU insertion (LRU) and bimodal insertion (BIP, LRU
+// position except once in 32 fills). A few leader sets always use one or the
+// other; their misses steer a 10-bit counter that picks for the rest
+class DIPPolicy : public ReplacementPolicy {
+    private:
+        enum { PSEL_MAX = 1023 };
+        std::vector<uint8_t> age;   // 0 is the most recent way of the set
+        int psel;
+        int leader_stride;
+
+        void moveTo(int set, int way, int position) {
+            uint8_t *setAge = &age[set * assoc];
+            int from = setAge[way];
+            for (int w = 0; w < assoc; w++) {
+                if (position < from && setAge[w] >= position && setAge[w] < from) setAge[w]++;
+                if (position > from && setAge[w] > from && setAge[w] <= position) setAge[w]--;
+            }
+            setAge[way] = position;
+        }
+        // 1 for an LRU leader, 2 for a BIP leader, 0 for a follower
+        int leader(int set) const {
+            int slot = set % leader_stride;
+            return slot == 0 ? 1 : slot == leader_stride - 1 ? 2 : 0;
+        }
+
+    public:
+        DIPPolicy(int sets, int assoc, uint64_t seed) : ReplacementPolicy(sets, assoc, seed), age(sets * assoc) {
+            // 32 leader sets of each kind, or a proportionally smaller number
+            leader_stride = std::max(4, sets / 32);
+            clear();
+        }
+        const char *name() const { return "dip"; }
+
+        void touch(int set, int way, const uint32_t *tags) { moveTo(set, way, 0); }
+
+        int victim(int set, const uint32_t *tags) {
+            int way = firstInvalid(tags, assoc);
+            if (way >= 0) {
+                return way;
+            }
+            const uint8_t *setAge = &age[set * assoc];
+            return std::max_element(setAge, setAge + assoc) - setAge;
+        }
+        void insert(int set, int way, const uint32_t *tags) {
+            int kind = leader(set);
+            if (kind == 1 && psel < PSEL_MAX) psel++;
+            if (kind == 2 && psel > 0) psel--;
+            bool bip = kind == 2 || (kind == 0 && psel > PSEL_MAX / 2);
+            moveTo(set, way, bip && (random() & 31) ? assoc - 1 : 0);
+        }
+        void clear() {
+            for (size_t i = 0; i < age.size(); i++) {
+                age[i] = i % assoc;
+            }
+            psel = PSEL_MAX / 2;
+        }
+
+        void save(CheckpointWriter &out) const { ReplacementPolicy::save(out); out.putVector(age); out.put(psel); }
+        void restore(CheckpointReader &in) { ReplacementPolicy::restore(in); in.getVector(age); psel = in.get<int>(); }
+};
+
+class RandomPolicy : public ReplacementPolicy {
+    public:
+        RandomPolicy(int sets, int assoc, uint64_t seed) : ReplacementPolicy(sets, assoc, seed) {}
+        const char *name() const { return "random"; }
+
+        void touch(int set, int way, const uint32_t *tags) {}
+        int victim(int set, const uint32_t *tags) {
+            int way = firstInvalid(tags, assoc);
+            return way >= 0 ? way : random() % assoc;
+        }
+        void insert(int set, int way, const uint32_t *tags) {}
+        void clear() {}
+};
+
+// Names accepted by --l1-repl/--l2-repl; "random" takes an optional seed
+// as "random:<seed>". Returns null for anything else
+inline std::unique_ptr<ReplacementPolicy> makeReplacementPolicy(const std::string &spec, int sets, int assoc)
+{
+    std::string name = spec.substr(0, spec.find(':'));
+    uint64_t seed = 1;
+    if (name.size() < spec.size()) {
+        char *end;
+        seed = strtoull(spec.c_str() + name.size() + 1, &end, 10);
+        if (name != "random" || *end || end == spec.c_str() + name.size() + 1) {
+            return nullptr;
+        }
+    }
+    ReplacementPolicy *policy = nullptr;
+    if (name == "lru") policy = new LRUPolicy(sets, assoc, seed);
+    else if (name == "plru" && !(assoc & (assoc - 1)) && assoc <= 32) policy = new TreePLRUPolicy(sets, assoc, seed);
+    else if (name == "srrip") policy = new RRIPPolicy(sets, assoc, seed, false);
+    else if (name == "brrip") policy = new RRIPPolicy(sets, assoc, seed, true);
+    else if (name == "dip") policy = new DIPPolicy(sets, assoc, seed);
+    else if (name == "random") policy = new RandomPolicy(sets, assoc, seed);
+    return std::unique_ptr<ReplacementPolicy>(policy);
+}
+#endif
@@ -0,0 +1,80 @@
+#include <cstdint>
+#include "processor.h"
+using namespace std;
+
+// Sampled simulation in the style of SMARTS: the program runs on the
+// single-cycle core with functional warming (caches and branch predictor
+// are updated, nothing is timed), and at intervals the out-of-order core
+// takes over from the same architectural state for a short detailed window.
+
+// Upper bound on the cycles a drain may take; only a core bug can hit it
+#define MAX_DRAIN_CYCLES 1000000
+
+uint64_t Processor::fastForward(uint32_t end_pc, uint64_t max_insts) {
+    memory->setOptLevel(0);
+    memory->setWarming(true);
+    warming = true;
+
+    uint64_t executed = 0;
+    while (executed < max_insts && regfile.pc <= end_pc) {
+        single_cycle_processor_advance();
+        executed++;
+    }
+
+    warming = false;
+    memory->setWarming(false);
+    return executed;
+}
+
+Processor::DetailedWindow Processor::runDetailed(uint32_t end_pc, uint64_t warmup, uint64_t measure) {
+    DetailedWindow window = {0, 0, 0, false};
+    memory->setOptLevel(opt_level);
+    restart_core = true;
+    fetch_enabled = true;
+
+    // Detailed warm-up, then the measured instructions
+    uint64_t start = core_committed;
+    uint64_t measure_start = start + warmup;
+    uint64_t measure_end = measure_start + measure;
+    uint64_t cycles = 0;
+    uint64_t measure_cycle = 0;
+    bool measuring = warmup == 0;
+    while (core_committed < measure_end) {
+        (this->*optimized_advance)();
+        cycles++;
+        cycles += skipIdleCycles(UINT64_MAX);
+        if (!measuring && core_committed >= measure_start) {
+            measuring = true;
+            measure_cycle = cycles;
+            measure_start = core_committed;
+        }
+        if (regfile.pc > end_pc) {
+            window.finished = true;
+            break;
+        }
+    }
+    if (measuring) {
+        window.cycles = cycles - measure_cycle;
+        window.measured = core_committed - measure_start;
+    }
+
+    // Stop fetching and let everything in flight commit, so the next
+    // architectural PC is wherever fetch would have continued
+    fetch_enabled = false;
+    for (int i = 0; !window.finished && !core_drained && i < MAX_DRAIN_CYCLES; i++) {
+        (this->*optimized_advance)();
+        if (regfile.pc > end_pc) {
+            window.finished = true;
+        }
+    }
+    fetch_enabled = true;
+    window.committed = core_committed - start;
+    if (!window.finished) {
+        regfile.pc = core_fetch_pc;
+    }
+
+    // The functional side reads and writes the backing store directly
+    memory->flushRequests();
+    memory->clean();
+    return window;
+}
@@ -0,0 +1,421 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <iostream>
+#include <thread>
+#include <getopt.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "processor.h"
+#include "loader.h"
+#include "threadpool.h"
+#include "writer.h"
+using namespace std;
+
+// `processor sweep`: runs every benchmark on every core configuration of a
+// matrix in one process, one simulation per job on a thread pool, and writes
+// a single result table. Each benchmark is read once; the jobs copy the
+// shared image into their own Memory.
+
+struct SweepConfig {
+    int opt_level;
+    int width;
+    int l1_size;
+    int l2_size;
+    string l1_repl;
+    string l2_repl;
+    int mshrs;
+    IssuePolicy issue;
+    string bpred;
+    const FunctionalUnits *units;
+};
+
+struct SweepResult {
+    uint64_t cycles;
+    uint64_t instructions;
+    double l1_miss_rate;
+    double l2_miss_rate;
+    double seconds;
+};
+
+static void sweep_help()
+{
+    cout << "Usage: processor sweep --bmk=<path>[,<path>...] [options]\n"
+            "Runs every benchmark on every combination of the listed settings and prints one\n"
+            "row per run. Lists are comma separated.\n"
+            "--bmk=<paths>                        Benchmark executables; a directory adds every file in it.\n"
+            "                                     May be given more than once\n"
+            "--opt=<levels>                       Optimization levels (0, 2, 3, 4; default 2). -O0 ignores\n"
+            "                                     --width, --issue and --bpred and runs once per cache\n"
+            "                                     configuration\n"
+            "--width=<widths>                     Superscalar widths (default 1)\n"
+            "--l1-size=<bytes>                    L1 cache sizes (default 32768)\n"
+            "--l2-size=<bytes>                    L2 cache sizes (default 262144)\n"
+            "--l1-repl=<policies>                 L1 replacement policies (lru, plru, srrip, brrip, dip,\n"
+            "                                     random[:<seed>]; default lru)\n"
+            "--l2-repl=<policies>                 L2 replacement policies (default lru)\n"
+            "--mshrs=<counts>                     MSHR counts (default 16)\n"
+            "--issue=<policies>                   Issue policies (oldest, index, branch-first, load-first;\n"
+            "                                     default oldest)\n"
+            "--bpred=<specs>                      Branch predictors (bimodal, gshare, tournament, tage,\n"
+            "                                     perceptron, with sizes as for a single run; default bimodal)\n"
+            "--ports, --fu-latency, --unpipelined, --result-buses\n"
+            "                                     Functional units, as for a single run; one setting for all rows\n"
+            "--jobs=<N>                           Worker threads (default: all host cores)\n"
+            "--format=csv|json                    Result table format (default csv)\n"
+            "--output=<path>                      Write the table here instead of stdout\n";
+}
+
+static bool parse_list(const char *arg, vector<int> &values)
+{
+    values.clear();
+    while (*arg) {
+        char *end;
+        long value = strtol(arg, &end, 10);
+        if (end == arg || (*end && *end != ',')) {
+            return false;
+        }
+        values.push_back(value);
+        arg = *end ? end + 1 : end;
+    }
+    return !values.empty();
+}
+
+static bool parse_names(const char *arg, vector<string> &values)
+{
+    values.clear();
+    string list = arg;
+    size_t begin = 0;
+    while (begin <= list.size()) {
+        size_t end = list.find(',', begin);
+        if (end == string::npos) end = list.size();
+        if (end == begin) {
+            return false;
+        }
+        values.push_back(list.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    return true;
+}
+
+// Adds a file, or every regular file in a directory (sorted by name)
+static void add_benchmarks(const string &path, vector<string> &benchmarks)
+{
+    struct stat info;
+    if (stat(path.c_str(), &info) || !S_ISDIR(info.st_mode)) {
+        benchmarks.push_back(path);
+        return;
+    }
+    vector<string> files;
+    if (DIR *dir = opendir(path.c_str())) {
+        while (struct dirent *entry = readdir(dir)) {
+            string file = path + "/" + entry->d_name;
+            if (entry->d_name[0] != '.' && !stat(file.c_str(), &info) && S_ISREG(info.st_mode)) {
+                files.push_back(file);
+            }
+        }
+        closedir(dir);
+    }
+    sort(files.begin(), files.end());
+    benchmarks.insert(benchmarks.end(), files.begin(), files.end());
+}
+
+static SweepResult simulate(const ProgramImage &image, const SweepConfig &config)
+{
+    Memory memory(config.l1_size, config.l2_size, config.l1_repl, config.l2_repl, config.mshrs);
+    Processor processor(&memory);
+    processor.initialize(config.opt_level);
+    processor.setIssuePolicy(config.issue);
+    processor.setBranchPredictor(config.bpred);
+    processor.setFunctionalUnits(*config.units);
+    processor.setWidth(config.width);
+    uint32_t end_pc = installProgram(image, memory);
+    processor.start(image.entry, 0);
+    memory.setOptLevel(config.opt_level);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    uint64_t cycles = 0;
+    while (processor.getPC() <= end_pc) {
+        processor.advance();
+        cycles++;
+        cycles += processor.skipIdleCycles(UINT64_MAX);
+    }
+    SweepResult result;
+    result.cycles = cycles;
+    // The single-cycle core retires one instruction per cycle
+    result.instructions = config.opt_level == 0 ? cycles : processor.committedInstructions();
+    result.l1_miss_rate = memory.missRate(0);
+    result.l2_miss_rate = memory.missRate(1);
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+// Writes a string as a JSON string literal
+static void put_json_string(BufferedWriter &out, const string &value)
+{
+    out << '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\') out << '\\';
+        out << c;
+    }
+    out << '"';
+}
+
+static void write_table(FILE *file, bool json, const vector<string> &benchmarks, const vector<SweepConfig> &configs,
+                        const vector<SweepResult> &results)
+{
+    BufferedWriter out(file);
+    if (json) {
+        out << "[\n";
+    } else {
+        out << "benchmark,opt,width,l1_size,l2_size,l1_repl,l2_repl,mshrs,issue,bpred,cycles,instructions,cpi,l1_miss_rate,l2_miss_rate,"
+               "seconds\n";
+    }
+    for (size_t b = 0; b < benchmarks.size(); b++) {
+        for (size_t c = 0; c < configs.size(); c++) {
+            const SweepConfig &config = configs[c];
+            const SweepResult &result = results[b * configs.size() + c];
+            double cpi = result.instructions ? (double)result.cycles / result.instructions : 0;
+            if (json) {
+                out << "  {\"benchmark\": ";
+                put_json_string(out, benchmarks[b]);
+                out << ", \"opt\": " << config.opt_level << ", \"width\": " << config.width <<
+                       ", \"l1_size\": " << config.l1_size << ", \"l2_size\": " << config.l2_size << ", \"l1_repl\": ";
+                put_json_string(out, config.l1_repl);
+                out << ", \"l2_repl\": ";
+                put_json_string(out, config.l2_repl);
+                out << ", \"mshrs\": " << config.mshrs << ", \"issue\": \"" << Processor::issuePolicyName(config.issue) <<
+                       "\", \"bpred\": ";
+                put_json_string(out, config.bpred);
+                out << ", \"cycles\": " << result.cycles << ", \"instructions\": " << result.instructions <<
+                       ", \"cpi\": ";
+                out.putFixed(cpi, 4);
+                out << ", \"l1_miss_rate\": ";
+                out.putFixed(result.l1_miss_rate, 4);
+                out << ", \"l2_miss_rate\": ";
+                out.putFixed(result.l2_miss_rate, 4);
+                out << ", \"seconds\": ";
+                out.putFixed(result.seconds, 3);
+                out << (b + 1 == benchmarks.size() && c + 1 == configs.size() ? "}\n" : "},\n");
+            } else {
+                out << benchmarks[b].c_str() << ',' << config.opt_level << ',' << config.width << ',' <<
+                       config.l1_size << ',' << config.l2_size << ',' << config.l1_repl.c_str() << ',' <<
+                       config.l2_repl.c_str() << ',' << config.mshrs << ',' << Processor::issuePolicyName(config.issue) << ',' <<
+                       config.bpred.c_str() << ',' << result.cycles << ',' << result.instructions << ',';
+                out.putFixed(cpi, 4);
+                out << ',';
+                out.putFixed(result.l1_miss_rate, 4);
+                out << ',';
+                out.putFixed(result.l2_miss_rate, 4);
+                out << ',';
+                out.putFixed(result.seconds, 3);
+                out << '\n';
+            }
+        }
+    }
+    if (json) {
+        out << "]\n";
+    }
+}
+
+int run_sweep(int argc, char *argv[])
+{
+    static struct option long_options[] = {
+      {"bmk", required_argument, 0, 'b'},
+      {"opt", required_argument, 0, 'O'},
+      {"width", required_argument, 0, 'w'},
+      {"l1-size", required_argument, 0, 'I'},
+      {"l2-size", required_argument, 0, 'K'},
+      {"l1-repl", required_argument, 0, 'X'},
+      {"l2-repl", required_argument, 0, 'Y'},
+      {"mshrs", required_argument, 0, 'M'},
+      {"issue", required_argument, 0, 'Z'},
+      {"bpred", required_argument, 0, 'B'},
+      {"ports", required_argument, 0, 'p'},
+      {"fu-latency", required_argument, 0, 'l'},
+      {"unpipelined", required_argument, 0, 'u'},
+      {"result-buses", required_argument, 0, 'r'},
+      {"jobs", required_argument, 0, 'j'},
+      {"format", required_argument, 0, 'f'},
+      {"output", required_argument, 0, 'o'},
+      {"help", no_argument, 0, 'h'},
+      {0, 0, 0, 0}
+    };
+    vector<string> benchmarks;
+    vector<int> opt_levels = {2};
+    vector<int> widths = {1};
+    vector<int> l1_sizes = {DEFAULT_L1_SIZE};
+    vector<int> l2_sizes = {DEFAULT_L2_SIZE};
+    vector<string> l1_repls = {"lru"};
+    vector<string> l2_repls = {"lru"};
+    vector<int> mshr_counts = {DEFAULT_MSHRS};
+    vector<string> issue_names = {"oldest"};
+    vector<string> bpreds = {"bimodal"};
+    FunctionalUnits units;
+    int jobs = thread::hardware_concurrency();
+    bool json = false;
+    const char *output = nullptr;
+
+    while (true) {
+      int c = getopt_long(argc, argv, "b:O:w:j:h", long_options, nullptr);
+      if (c == -1) {
+          break;
+      }
+      bool ok = true;
+      switch (c) {
+          case 'b': {
+              string list = optarg;
+              size_t begin = 0;
+              while (begin <= list.size()) {
+                  size_t end = list.find(',', begin);
+                  if (end == string::npos) end = list.size();
+                  if (end > begin) add_benchmarks(list.substr(begin, end - begin), benchmarks);
+                  begin = end + 1;
+              }
+              break;
+          }
+          case 'O': ok = parse_list(optarg, opt_levels); break;
+          case 'w': ok = parse_list(optarg, widths); break;
+          case 'I': ok = parse_list(optarg, l1_sizes); break;
+          case 'K': ok = parse_list(optarg, l2_sizes); break;
+          case 'X': ok = parse_names(optarg, l1_repls); break;
+          case 'Y': ok = parse_names(optarg, l2_repls); break;
+          case 'M': ok = parse_list(optarg, mshr_counts); break;
+          case 'Z': ok = parse_names(optarg, issue_names); break;
+          case 'B': ok = parse_names(optarg, bpreds); break;
+          case 'p': ok = units.setPorts(optarg); break;
+          case 'l': ok = units.setLatencies(optarg); break;
+          case 'u': ok = units.setUnpipelined(optarg); break;
+          case 'r': units.result_buses = atoi(optarg); ok = units.result_buses >= 0; break;
+          case 'j': jobs = atoi(optarg); break;
+          case 'f':
+              json = !strcmp(optarg, "json");
+              ok = json || !strcmp(optarg, "csv");
+              break;
+          case 'o': output = optarg; break;
+          default:
+              sweep_help();
+              return c == 'h' ? 0 : 1;
+      }
+      if (!ok) {
+          cout << "Bad option value: " << optarg << "\n";
+          return 1;
+      }
+    }
+    if (benchmarks.empty()) {
+        sweep_help();
+        return 1;
+    }
+
+    vector<IssuePolicy> issues(issue_names.size());
+    for (size_t i = 0; i < issue_names.size(); i++) {
+        if (!Processor::issuePolicyByName(issue_names[i], issues[i])) {
+            cout << "Unknown issue policy: " << issue_names[i] << "\n";
+            return 1;
+        }
+    }
+    for (const string &bpred : bpreds) {
+        if (!BranchPredictor::valid(bpred)) {
+            cout << "Unknown branch predictor: " << bpred << "\n";
+            return 1;
+        }
+    }
+
+    // The matrix, in the order rows are printed
+    vector<SweepConfig> configs;
+    for (int opt_level : opt_levels) {
+        if (opt_level < 0 || opt_level > 4 || opt_level == 1) {
+            cout << "Unsupported optimization level for a sweep: " << opt_level << "\n";
+            return 1;
+        }
+        for (int width : widths) {
+            Memory scratch_memory;
+            if (!Processor(&scratch_memory).setWidth(width)) {
+                cout << "Unsupported width: " << width << "\n";
+                return 1;
+            }
+            if (opt_level == 0 && width != widths[0]) {
+                continue;
+            }
+            for (int l1_size : l1_sizes) {
+                for (int l2_size : l2_sizes) {
+                    if (!Memory::validCacheSizes(l1_size, l2_size)) {
+                        cout << "Unsupported cache sizes: L1 " << l1_size << ", L2 " << l2_size << "\n";
+                        return 1;
+                    }
+                    for (const string &l1_repl : l1_repls) {
+                        for (const string &l2_repl : l2_repls) {
+                            for (int mshrs : mshr_counts) {
+                                if (mshrs < 1 || mshrs > MAX_MSHRS) {
+                                    cout << "Unsupported MSHR count: " << mshrs << "\n";
+                                    return 1;
+                                }
+                                for (IssuePolicy issue : issues) {
+                                    for (const string &bpred : bpreds) {
+                                        if (opt_level == 0 && (issue != issues[0] || bpred != bpreds[0])) {
+                                            continue;
+                                        }
+                                        configs.push_back({opt_level, opt_level == 0 ? 1 : width, l1_size, l2_size,
+                                                           l1_repl, l2_repl, mshrs, issue, bpred, &units});
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    for (const vector<string> *repls : {&l1_repls, &l2_repls}) {
+        for (const string &repl : *repls) {
+            if (!Memory::validReplacementPolicy(repl)) {
+                cout << "Unknown replacement policy: " << repl << "\n";
+                return 1;
+            }
+        }
+    }
+
+    vector<ProgramImage> images(benchmarks.size());
+    for (size_t b = 0; b < benchmarks.size(); b++) {
+        if (!readProgram(benchmarks[b].c_str(), images[b])) {
+            return 1;
+        }
+    }
+
+    FILE *file = output ? fopen(output, "w") : stdout;
+    if (!file) {
+        cout << "Failed to open output file: " << output << "\n";
+        return 1;
+    }
+
+    // Every job writes only its own result slot
+    size_t total = benchmarks.size() * configs.size();
+    vector<SweepResult> results(total);
+    size_t finished = 0;
+    mutex progress;
+    ThreadPool pool(jobs);
+    for (size_t b = 0; b < benchmarks.size(); b++) {
+        for (size_t c = 0; c < configs.size(); c++) {
+            pool.submit([&, b, c] {
+                results[b * configs.size() + c] = simulate(images[b], configs[c]);
+                lock_guard<mutex> guard(progress);
+                cerr << "[" << ++finished << "/" << total << "] " << benchmarks[b] << " -O" << configs[c].opt_level <<
+                        " --width=" << configs[c].width << "\n";
+            });
+        }
+    }
+    pool.run();
+
+    write_table(file, json, benchmarks, configs, results);
+    if (output) {
+        fclose(file);
+    }
+    return 0;
+}
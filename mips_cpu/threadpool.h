@@ -0,0 +1,65 @@
+#ifndef THREAD_POOL
+#define THREAD_POOL
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <functional>
+
+// Work-stealing pool for a batch of independent jobs. Jobs are dealt out to
+// per-worker deques up front; a worker takes the newest job from its own
+// deque and, once that is empty, steals the oldest job from another's, so a
+// few long simulations do not leave the other cores idle at the end.
+// Jobs may not submit further jobs.
+class ThreadPool {
+    private:
+        struct WorkQueue {
+            std::mutex lock;
+            std::deque<std::function<void()>> jobs;
+        };
+        std::vector<std::unique_ptr<WorkQueue>> queues;
+        size_t next;
+
+        bool take(size_t self, std::function<void()> &job) {
+            for (size_t i = 0; i < queues.size(); i++) {
+                WorkQueue &queue = *queues[(self + i) % queues.size()];
+                std::lock_guard<std::mutex> guard(queue.lock);
+                if (queue.jobs.empty()) continue;
+                if (i == 0) {
+                    job = std::move(queue.jobs.back());
+                    queue.jobs.pop_back();
+                } else {
+                    job = std::move(queue.jobs.front());
+                    queue.jobs.pop_front();
+                }
+                return true;
+            }
+            return false;
+        }
+
+    public:
+        ThreadPool(int threads) : next(0) {
+            for (int i = 0; i < (threads > 0 ? threads : 1); i++) {
+                queues.emplace_back(new WorkQueue);
+            }
+        }
+
+        void submit(std::function<void()> job) {
+            queues[next++ % queues.size()]->jobs.push_back(std::move(job));
+        }
+
+        // Runs everything submitted so far and returns once it has finished
+        void run() {
+            std::vector<std::thread> workers;
+            for (size_t self = 0; self < queues.size(); self++) {
+                workers.emplace_back([this, self] {
+                    std::function<void()> job;
+                    while (take(self, job)) job();
+                });
+            }
+            for (std::thread &worker : workers) worker.join();
+            next = 0;
+        }
+};
+#endif
@@ -0,0 +1,92 @@
+#ifndef BUFFERED_WRITER
+#define BUFFERED_WRITER
+#include <vector>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+// Collects simulator output in one large buffer and hands it to stdio in big
+// chunks. Nothing here flushes on its own, so per-cycle dumps never stall the
+// simulation loop on the terminal; call flush() once the run is over.
+class BufferedWriter {
+    private:
+        std::vector<char> buffer;
+        size_t used;
+        FILE *out;
+
+        void drain() {
+            fwrite(buffer.data(), 1, used, out);
+            used = 0;
+        }
+
+        void putUnsigned(unsigned long long value) {
+            char digits[20];
+            int n = 0;
+            do {
+                digits[n++] = '0' + value % 10;
+                value /= 10;
+            } while (value);
+            if (used + n > buffer.size()) drain();
+            while (n) buffer[used++] = digits[--n];
+        }
+
+        void putSigned(long long value) {
+            if (value < 0) {
+                *this << '-';
+                putUnsigned(0ULL - (unsigned long long)value);
+            } else {
+                putUnsigned(value);
+            }
+        }
+
+    public:
+        BufferedWriter(FILE *file = stdout, size_t capacity = 1 << 20) : buffer(capacity), used(0), out(file) {}
+        ~BufferedWriter() { flush(); }
+
+        void write(const char *data, size_t length) {
+            if (used + length > buffer.size()) {
+                drain();
+                if (length > buffer.size()) {
+                    fwrite(data, 1, length, out);
+                    return;
+                }
+            }
+            memcpy(&buffer[used], data, length);
+            used += length;
+        }
+
+        // Prints value as lowercase hex without a 0x prefix
+        void putHex(uint32_t value) {
+            char digits[8];
+            int n = 0;
+            do {
+                digits[n++] = "0123456789abcdef"[value & 0xf];
+                value >>= 4;
+            } while (value);
+            if (used + n > buffer.size()) drain();
+            while (n) buffer[used++] = digits[--n];
+        }
+
+        // Prints value with a fixed number of decimals
+        void putFixed(double value, int decimals) {
+            char digits[64];
+            int n = snprintf(digits, sizeof(digits), "%.*f", decimals, value);
+            write(digits, n > 0 ? n : 0);
+        }
+
+        BufferedWriter &operator<<(const char *s) { write(s, strlen(s)); return *this; }
+        BufferedWriter &operator<<(char c) { write(&c, 1); return *this; }
+        BufferedWriter &operator<<(int value) { putSigned(value); return *this; }
+        BufferedWriter &operator<<(long value) { putSigned(value); return *this; }
+        BufferedWriter &operator<<(long long value) { putSigned(value); return *this; }
+        BufferedWriter &operator<<(unsigned value) { putUnsigned(value); return *this; }
+        BufferedWriter &operator<<(unsigned long value) { putUnsigned(value); return *this; }
+        BufferedWriter &operator<<(unsigned long long value) { putUnsigned(value); return *this; }
+
+        // Hands everything buffered so far to the output stream
+        void flush() {
+            drain();
+            fflush(out);
+        }
+};
+#endif
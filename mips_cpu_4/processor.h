@@ -1,35 +0,0 @@
-#include "memory.h"
-#include "regfile.h"
-#include "ALU.h"
-#include "control.h"
-class Processor {
-    private:
-        int opt_level;
-        ALU alu;
-        control_t control;
-        Memory *memory;
-        Registers regfile;
-        // add other structures as needed
-
-        // pipelined processor
-
-        // add private functions
-        void single_cycle_processor_advance();
-        void pipelined_processor_advance();
-        void optimized_processor_advance();
- 
-    public:
-        Processor(Memory *mem) { regfile.pc = 0; memory = mem;}
-
-        // Get PC
-        uint32_t getPC() { return regfile.pc; }
-
-        // Prints the Register File
-        void printRegFile() { regfile.print(); }
-        
-        // Initializes the processor appropriately based on the optimization level
-        void initialize(int opt_level);
-
-        // Advances the processor to an appropriate state every cycle
-        void advance(); 
-};
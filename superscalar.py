@@ -7,10 +7,7 @@ files = superscalar
 
 # === Processor Executables ===
 pipeline_exec = "/u/yzp7fe/processor/pipeline/processor"
-way_1_exec = "/u/yzp7fe/processor/mips_cpu_1/processor"
-way_2_exec = "/u/yzp7fe/processor/mips_cpu_2/processor"
-way_4_exec = "/u/yzp7fe/processor/mips_cpu_4/processor"
-way_8_exec = "/u/yzp7fe/processor/mips_cpu_8/processor"
+optimized_exec = "/u/yzp7fe/processor/mips_cpu/processor"
 
 # === Paths ===
 compile_path = "/u/yzp7fe/processor/compile/"
@@ -23,9 +20,9 @@ way_4_cycles = []
 way_8_cycles = []
 
 # === Helper Function ===
-def run_and_get_cycles(proc_path, opt_flag, input_path):
+def run_and_get_cycles(proc_path, opt_flag, input_path, extra_args=[]):
     result = subprocess.run(
-        [proc_path, "-b", input_path, opt_flag],
+        [proc_path, "-b", input_path, opt_flag] + extra_args,
         stdout=subprocess.PIPE,
         stderr=subprocess.STDOUT,
         text=True
@@ -38,10 +35,10 @@ for file in files:
     print(f"Running {file}...")
 
     pipeline_cycles.append(run_and_get_cycles(pipeline_exec, "-O1", input_path))
-    way_1_cycles.append(run_and_get_cycles(way_1_exec, "-O2", input_path))
-    way_2_cycles.append(run_and_get_cycles(way_2_exec, "-O2", input_path))
-    way_4_cycles.append(run_and_get_cycles(way_4_exec, "-O2", input_path))
-    way_8_cycles.append(run_and_get_cycles(way_8_exec, "-O2", input_path))
+    way_1_cycles.append(run_and_get_cycles(optimized_exec, "-O2", input_path, ["--width=1", "--quiet"]))
+    way_2_cycles.append(run_and_get_cycles(optimized_exec, "-O2", input_path, ["--width=2", "--quiet"]))
+    way_4_cycles.append(run_and_get_cycles(optimized_exec, "-O2", input_path, ["--width=4", "--quiet"]))
+    way_8_cycles.append(run_and_get_cycles(optimized_exec, "-O2", input_path, ["--width=8", "--quiet"]))
 
 # === Plot: Cycle Count Comparison (Bar Chart) ===
 x = range(len(files))